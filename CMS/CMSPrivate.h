@@ -156,6 +156,20 @@ OSStatus CMSDecoderGetDecoder(
 	CMSDecoderRef		cmsDecoder,
 	SecCmsDecoderRef	*decoder);			/* RETURNED */
 
+/*
+ * Stream the encapsulated content of the message to a callback as it is
+ * decoded instead of accumulating it in the decoder. Digests are still
+ * computed incrementally, so signer status is available as usual after
+ * CMSDecoderFinalizeMessage(); CMSDecoderCopyContent() returns NULL content.
+ * Peak memory is then bounded by the certificate and signerInfo sections
+ * rather than the payload. Must be called before the first call to
+ * CMSDecoderUpdateMessage() and cannot be combined with CMSDecoderSetDecoder().
+ */
+OSStatus CMSDecoderSetContentCallback(
+	CMSDecoderRef			cmsDecoder,
+	SecCmsContentCallback	callback,
+	void					*callbackArg);
+
 /*
  * Obtain the Hash Agility attribute value of signer 'signerIndex'
  * of a CMS message, if present.
@@ -294,6 +294,7 @@ static bool _truncate_db(authdb_connection_t dbconn)
     int32_t rc = SQLITE_ERROR;
     int32_t flags = SQLITE_TRUNCATE_JOURNALMODE_WAL | SQLITE_TRUNCATE_AUTOVACUUM_FULL;
     rc = sqlite3_file_control(dbconn->handle, NULL, SQLITE_TRUNCATE_DATABASE, &flags);
+    rule_cache_invalidate();
     if (rc != SQLITE_OK) {
         os_log_debug(AUTHD_LOG, "Failed to delete db handle! SQLite error %i.", rc);
         if (rc == SQLITE_IOERR) {
@@ -1119,6 +1120,7 @@ authdb_import_plist(authdb_connection_t dbconn, CFDictionaryRef plist, bool vers
     }
     
     authdb_checkpoint(dbconn);
+    rule_cache_invalidate();
     
 done:
     CFReleaseSafe(rights);
@@ -1177,23 +1177,15 @@ _find_rule(engine_t engine, authdb_connection_t dbconn, const char * string)
     char * buf = calloc(1u, sLen + 1);
     strlcpy(buf, string, sLen + 1);
     char * ptr = buf + sLen;
-    __block int64_t count = 0;
     
     for (;;) {
         
-        // lookup rule
-        authdb_step(dbconn, "SELECT COUNT(name) AS cnt FROM rules WHERE name = ? AND type = 1",
-        ^(sqlite3_stmt *stmt) {
-            sqlite3_bind_text(stmt, 1, buf, -1, NULL);
-        }, ^bool(auth_items_t data) {
-            count = auth_items_get_int64(data, "cnt");
-            return false;
-        });
-        
-        if (count > 0) {
-            r = rule_create_with_string(buf, dbconn);
+        // lookup rule (misses are cached as well, so wildcard walks stay off the db)
+        r = rule_copy_cached(buf, dbconn);
+        if (r && rule_get_id(r) != 0 && rule_get_type(r) == RT_RIGHT) {
             goto done;
         }
+        CFReleaseNull(r);
         
         // if buf ends with a . and we didn't find a rule remove .
         if (*ptr == '.') {
@@ -1213,8 +1205,8 @@ done:
     
     // set default if we didn't find a rule
     if (r == NULL) {
-        r = rule_create_with_string("", dbconn);
-        if (rule_get_id(r) == 0) {
+        r = rule_copy_cached("", dbconn);
+        if (!r || rule_get_id(r) == 0) {
             CFReleaseNull(r);
             os_log_error(AUTHD_LOG, "Default rule lookup error (missing), using builtin defaults (engine %lld)", engine->engine_index);
             r = rule_create_default();
@@ -1539,7 +1531,7 @@ OSStatus engine_authorize(engine_t engine, auth_rights_t rights, auth_items_t en
             os_log_debug(AUTHD_LOG, "setting hints for UI authorization");
             _set_localization_hints(dbconn, engine->hints, rule);
             if (!engine->authenticateRule) {
-                engine->authenticateRule = rule_create_with_string("authenticate", dbconn);
+                engine->authenticateRule = rule_copy_cached("authenticate", dbconn);
             }
         }
         
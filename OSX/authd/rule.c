@@ -22,6 +22,10 @@ static bool _copy_cf_rule_delegations(rule_t, CFTypeRef,authdb_connection_t);
 
 #define kMaximumAuthorizationTries 10000
 
+// Upper bound on cached lookups; client supplied right names that miss are
+// cached too, so the whole cache is dropped when it grows past this.
+#define kRuleCacheMaxEntries 1024
+
 #define RULE_ID "id"
 #define RULE_NAME "name"
 #define RULE_TYPE "type"
@@ -199,6 +203,89 @@ done:
     return rule;
 }
 
+static dispatch_queue_t
+_rule_cache_queue(void)
+{
+    static dispatch_queue_t queue = NULL;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.apple.security.auth.rulecache", DISPATCH_QUEUE_SERIAL);
+    });
+    
+    return queue;
+}
+
+static CFMutableDictionaryRef rule_cache = NULL;
+static uint64_t rule_cache_generation = 0;
+
+// Resolve everything the rule getters otherwise fill in lazily so a cached
+// rule is never written to again once other engines can see it.
+static bool
+_rule_cache_seal(rule_t rule)
+{
+    rule_get_requirement(rule);
+    rule_mechanisms_iterator(rule, ^bool(mechanism_t mech) {
+        mechanism_get_string(mech);
+        mechanism_exists(mech);
+        return true;
+    });
+    rule_delegates_iterator(rule, ^bool(rule_t delegate) {
+        return _rule_cache_seal(delegate);
+    });
+    return true;
+}
+
+rule_t
+rule_copy_cached(const char * str, authdb_connection_t dbconn)
+{
+    __block rule_t rule = NULL;
+    __block uint64_t generation = 0;
+    CFStringRef key = NULL;
+    require(str != NULL, done);
+    
+    key = CFStringCreateWithCString(kCFAllocatorDefault, str, kCFStringEncodingUTF8);
+    require(key != NULL, done);
+    
+    dispatch_sync(_rule_cache_queue(), ^{
+        generation = rule_cache_generation;
+        if (rule_cache) {
+            rule = (rule_t)CFDictionaryGetValue(rule_cache, key);
+            CFRetainSafe(rule);
+        }
+    });
+    require_quiet(rule == NULL, done);
+    
+    rule = rule_create_with_string(str, dbconn);
+    require(rule != NULL, done);
+    _rule_cache_seal(rule);
+    
+    dispatch_sync(_rule_cache_queue(), ^{
+        // a commit in the meantime may have raced our fetch; don't keep it
+        if (generation != rule_cache_generation) {
+            return;
+        }
+        if (!rule_cache || CFDictionaryGetCount(rule_cache) >= kRuleCacheMaxEntries) {
+            CFReleaseSafe(rule_cache);
+            rule_cache = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        }
+        CFDictionarySetValue(rule_cache, key, rule);
+    });
+    
+done:
+    CFReleaseSafe(key);
+    return rule;
+}
+
+void
+rule_cache_invalidate(void)
+{
+    dispatch_sync(_rule_cache_queue(), ^{
+        rule_cache_generation++;
+        CFReleaseNull(rule_cache);
+    });
+}
+
 static void _set_data_string(rule_t rule, const char * key, CFStringRef str)
 {
     char * tmpStr = _copy_cf_string(str, NULL);
@@ -805,6 +892,7 @@ done:
     if (!result) {
         os_log_debug(AUTHD_LOG, "rule: commit, failed for %{public}s (%llu)", rule_get_name(rule), rule_get_id(rule));
     } else {
+        rule_cache_invalidate();
         rule_log_manipulation(dbconn, rule, insert ? rule_insert : rule_update, proc);
     }
     return result;
@@ -828,6 +916,7 @@ rule_sql_remove(rule_t rule, authdb_connection_t dbconn, process_t proc)
                          }, NULL);
     
     if (result) {
+        rule_cache_invalidate();
         rule_log_manipulation(dbconn, rule, rule_delete, proc);
     }
     
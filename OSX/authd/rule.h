@@ -55,6 +55,11 @@ rule_t rule_create_default(void);
 AUTH_WARN_RESULT AUTH_MALLOC AUTH_NONNULL1 AUTH_RETURNS_RETAINED
 rule_t rule_create_with_string(const char *,authdb_connection_t);
         
+AUTH_WARN_RESULT AUTH_NONNULL1 AUTH_RETURNS_RETAINED
+rule_t rule_copy_cached(const char *,authdb_connection_t);
+
+void rule_cache_invalidate(void);
+
 AUTH_WARN_RESULT AUTH_MALLOC AUTH_NONNULL_ALL AUTH_RETURNS_RETAINED
 rule_t rule_create_with_plist(RuleType,CFStringRef,CFDictionaryRef,authdb_connection_t);
 
@@ -144,6 +144,10 @@ protected:
 	 *
 	 * The subclass throws CSSMERR_CSP_INPUT_LENGTH_ERROR if the above
 	 * conditions are not met.  
+	 *
+	 * A subclass which sets multiBlockCapable(true) must also accept any
+	 * whole number of blocks in one call; update() then hands it all the
+	 * aligned input at once (ECB, or CBC when cbcCapable).
 	 */
 	virtual void encryptBlock(
 		const void		*plainText,			// length implied (one block)
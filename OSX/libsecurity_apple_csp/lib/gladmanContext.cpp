@@ -32,10 +32,12 @@ GAESContext::GAESContext(AppleCSPSession &session) :
 	mAesKey(NULL),
 	mInitFlag(false),
 	mRawKeySize(0),
-	mWasEncrypting(false)
+	mWasEncrypting(false),
+	mWasChaining(false)
 { 
-	cbcCapable(false);
-	multiBlockCapable(false);
+	/* CommonCrypto does the chaining and takes whole runs of blocks per call */
+	cbcCapable(true);
+	multiBlockCapable(true);
 }
 
 GAESContext::~GAESContext()
@@ -72,6 +74,8 @@ void GAESContext::init(
 	CSSM_SIZE	keyLen;
 	uint8 		*keyData = NULL;
 	bool		sameKeySize = false;
+	bool		chaining = false;
+	CssmData	*iv = NULL;
 	
 	/* obtain key from context */
 	symmetricKeyBits(context, session(), CSSM_ALGID_AES, 
@@ -97,76 +101,110 @@ void GAESContext::init(
 		deleteKey();
 	}
 	
-	/* 
-	 * Init key only if key size or key bits have changed, or 
-	 * we're doing a different operation than the previous key
-	 * was scheduled for.
-	 */
-	if(!sameKeySize || (mWasEncrypting != encrypting) ||
-		memcmp(mRawKey, keyData, mRawKeySize)) {
-        (void) CCCryptorCreateWithMode(0, kCCModeECB, kCCAlgorithmAES128, ccDefaultPadding, NULL, keyData, keyLen, NULL, 0, 0, 0, &mAesKey);
-
-		/* save this raw key data */
-		memmove(mRawKey, keyData, keyLen); 
-		mRawKeySize = (uint32)keyLen;
-		mWasEncrypting = encrypting;
-	}
-
-	/* we handle CBC, and hence the IV, ourselves */
+	/* CommonCrypto does CBC, and hence holds the IV; BlockCryptor only pads */
 	CSSM_ENCRYPT_MODE cssmMode = context.getInt(CSSM_ATTRIBUTE_MODE);
     switch (cssmMode) {
 		/* no mode attr --> 0 == CSSM_ALGMODE_NONE, not currently supported */
  		case CSSM_ALGMODE_CBCPadIV8:
 		case CSSM_ALGMODE_CBC_IV8:
 		{
-			CssmData *iv = context.get<CssmData>(CSSM_ATTRIBUTE_INIT_VECTOR);
+			iv = context.get<CssmData>(CSSM_ATTRIBUTE_INIT_VECTOR);
 			if(iv == NULL) {
 				CssmError::throwMe(CSSMERR_CSP_MISSING_ATTR_INIT_VECTOR);
 			}
 			if(iv->Length != kCCBlockSizeAES128) {
 				CssmError::throwMe(CSSMERR_CSP_INVALID_ATTR_INIT_VECTOR);
 			}
+			chaining = true;
 		}
 		break;
 		default:
 		break;
 	}
+
+	/* 
+	 * Init key only if key size or key bits have changed, or 
+	 * we're doing a different operation or mode than the previous 
+	 * cryptor was created for. Otherwise just rewind it to the new IV.
+	 */
+	if(mAesKey == NULL || !sameKeySize || (mWasEncrypting != encrypting) ||
+		(mWasChaining != chaining) || memcmp(mRawKey, keyData, mRawKeySize)) {
+		if(mAesKey) {
+			CCCryptorRelease(mAesKey);
+			mAesKey = NULL;
+		}
+		CCCryptorStatus crtn = CCCryptorCreateWithMode(
+			encrypting ? kCCEncrypt : kCCDecrypt,
+			chaining ? kCCModeCBC : kCCModeECB,
+			kCCAlgorithmAES128, ccNoPadding,
+			chaining ? iv->Data : NULL,
+			keyData, keyLen, NULL, 0, 0, 0, &mAesKey);
+		if(crtn != kCCSuccess) {
+			errorLog1("GAESContext::init: CCCryptorCreateWithMode (%d)\n", (int)crtn);
+			CssmError::throwMe(CSSMERR_CSP_INTERNAL_ERROR);
+		}
+
+		/* save this raw key data */
+		memmove(mRawKey, keyData, keyLen); 
+		mRawKeySize = (uint32)keyLen;
+		mWasEncrypting = encrypting;
+		mWasChaining = chaining;
+	}
+	else if(CCCryptorReset(mAesKey, chaining ? iv->Data : NULL) != kCCSuccess) {
+		CssmError::throwMe(CSSMERR_CSP_INTERNAL_ERROR);
+	}
 	
 	/* Finally, have BlockCryptor do its setup */
 	setup(GLADMAN_BLOCK_SIZE_BYTES, context);
 	mInitFlag = true;
 }	
 
+/*
+ * Run any whole number of blocks through the cryptor. Chaining state
+ * carries over between calls, so BlockCryptor can hand us everything it
+ * has in one go.
+ */
+void GAESContext::cryptBlocks(
+	const void		*in,
+	size_t			inLen,
+	void			*out,
+	size_t			&outLen)			// in/out, throws on overflow
+{
+	if(inLen % GLADMAN_BLOCK_SIZE_BYTES) {
+		CssmError::throwMe(CSSMERR_CSP_INPUT_LENGTH_ERROR);
+	}
+	if(outLen < inLen) {
+		CssmError::throwMe(CSSMERR_CSP_OUTPUT_LENGTH_ERROR);
+	}
+	size_t moved = 0;
+	CCCryptorStatus crtn = CCCryptorUpdate(mAesKey, in, inLen, out, outLen, &moved);
+	if((crtn != kCCSuccess) || (moved != inLen)) {
+		errorLog1("GAESContext: CCCryptorUpdate (%d)\n", (int)crtn);
+		CssmError::throwMe(CSSMERR_CSP_INTERNAL_ERROR);
+	}
+	outLen = moved;
+}
+
 /*
  * Functions called by BlockCryptor
- * FIXME make this multi-block capabl3e 
  */
 void GAESContext::encryptBlock(
-	const void		*plainText,			// length implied (one block)
+	const void		*plainText,			// length: any multiple of the block size
 	size_t			plainTextLen,
 	void 			*cipherText,	
 	size_t			&cipherTextLen,		// in/out, throws on overflow
 	bool			final)				// ignored
 {
-	if(cipherTextLen < plainTextLen) {
-		CssmError::throwMe(CSSMERR_CSP_OUTPUT_LENGTH_ERROR);
-	}
-    (void) CCCryptorEncryptDataBlock(mAesKey, NULL, plainText, plainTextLen, cipherText);
-
-	cipherTextLen = plainTextLen;
+	cryptBlocks(plainText, plainTextLen, cipherText, cipherTextLen);
 }
 
 void GAESContext::decryptBlock(
-	const void		*cipherText,		// length implied (one cipher block)
+	const void		*cipherText,		// length: any multiple of the block size
 	size_t			cipherTextLen,	
 	void			*plainText,	
 	size_t			&plainTextLen,		// in/out, throws on overflow
 	bool			final)				// ignored
 {
-	if(plainTextLen < cipherTextLen) {
-		CssmError::throwMe(CSSMERR_CSP_OUTPUT_LENGTH_ERROR);
-	}
-    (void) CCCryptorDecryptDataBlock(mAesKey, NULL, cipherText, cipherTextLen, plainText);
-	plainTextLen = cipherTextLen;
+	cryptBlocks(cipherText, cipherTextLen, plainText, plainTextLen);
 }
 
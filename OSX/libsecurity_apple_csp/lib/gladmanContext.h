@@ -63,6 +63,11 @@ public:
 	
 private:
 	void deleteKey();
+	void cryptBlocks(
+		const void		*in,
+		size_t			inLen,
+		void			*out,
+		size_t			&outLen);
 	
 	/* scheduled key */
     CCCryptorRef	mAesKey;	
@@ -77,6 +82,7 @@ private:
 	uint8				mRawKey[MAX_AES_KEY_BITS / 8];
 	uint32				mRawKeySize;
 	bool				mWasEncrypting;
+	bool				mWasChaining;		// cryptor was created in CBC mode
 };	/* AESContext */
 
 #endif //_H_GLADMAN_CONTEXT
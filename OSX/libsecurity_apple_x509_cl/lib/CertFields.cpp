@@ -32,6 +32,7 @@
 #include <Security/oidscert.h>
 #include <Security/x509defs.h>
 #include <security_utilities/utilities.h>
+#include <security_utilities/globalizer.h>
 
 /***
  *** Version
@@ -674,16 +675,111 @@ static const oidToFieldFuncs fieldFuncTable[] = {
 #define NUM_KNOWN_FIELDS		(sizeof(fieldFuncTable) / sizeof(oidToFieldFuncs))
 #define NUM_STD_CERT_FIELDS		17		/* not including extensions */
 
+/*
+ * Perfect hash from field OID to fieldFuncTable entry. The table size and
+ * hash seed are searched for once, at first use, such that every known OID
+ * gets a slot of its own; a lookup is then one hash, one probe and one
+ * OID compare regardless of where the field sits in fieldFuncTable.
+ */
+class CertFieldIndex
+{
+public:
+	CertFieldIndex();
+	const oidToFieldFuncs *lookup(
+		const CssmOid		&fieldId) const;
+
+private:
+	enum { kMaxSlots = 512 };
+	static uint32 hash(
+		const CSSM_DATA		&oid,
+		uint32				seed);
+	bool build(
+		uint32				numSlots,
+		uint32				seed);
+
+	uint32					mSeed;
+	uint32					mMask;			// 0 if no perfect hash was found
+	uint8					mSlots[kMaxSlots];	// fieldFuncTable index + 1, 0 = empty
+};
+
+CertFieldIndex::CertFieldIndex()
+	: mSeed(0), mMask(0)
+{
+	for(uint32 numSlots = 64; numSlots <= kMaxSlots; numSlots <<= 1) {
+		for(uint32 seed = 1; seed < 1024; seed++) {
+			if(build(numSlots, seed)) {
+				return;
+			}
+		}
+	}
+	/* can't happen with the current table; lookup() falls back to a scan */
+	clErrorLog("CertFieldIndex: no perfect hash for %u fields\n",
+		(unsigned)NUM_KNOWN_FIELDS);
+	mMask = 0;
+}
+
+uint32 CertFieldIndex::hash(
+	const CSSM_DATA		&oid,
+	uint32				seed)
+{
+	/* FNV-1a, seeded */
+	uint32 h = 2166136261U ^ seed;
+	for(CSSM_SIZE i=0; i<oid.Length; i++) {
+		h ^= oid.Data[i];
+		h *= 16777619U;
+	}
+	return h ^ (h >> 15);
+}
+
+bool CertFieldIndex::build(
+	uint32				numSlots,
+	uint32				seed)
+{
+	static_assert(NUM_KNOWN_FIELDS < 255, "fieldFuncTable too big for CertFieldIndex");
+	memset(mSlots, 0, sizeof(mSlots));
+	for(unsigned i=0; i<NUM_KNOWN_FIELDS; i++) {
+		uint32 slot = hash(*fieldFuncTable[i].fieldId, seed) & (numSlots - 1);
+		if(mSlots[slot] != 0) {
+			return false;
+		}
+		mSlots[slot] = i + 1;
+	}
+	mSeed = seed;
+	mMask = numSlots - 1;
+	return true;
+}
+
+const oidToFieldFuncs *CertFieldIndex::lookup(
+	const CssmOid		&fieldId) const
+{
+	if(mMask == 0) {
+		for(unsigned i=0; i<NUM_KNOWN_FIELDS; i++) {
+			if(fieldId == CssmData::overlay(*fieldFuncTable[i].fieldId)) {
+				return &fieldFuncTable[i];
+			}
+		}
+		return NULL;
+	}
+	uint8 entry = mSlots[hash(fieldId, mSeed) & mMask];
+	if(entry == 0) {
+		return NULL;
+	}
+	const oidToFieldFuncs *fieldFuncs = &fieldFuncTable[entry - 1];
+	if(fieldId != CssmData::overlay(*fieldFuncs->fieldId)) {
+		return NULL;
+	}
+	return fieldFuncs;
+}
+
+static ModuleNexus<CertFieldIndex> certFieldIndex;
+
 /* map an OID to an oidToFieldFuncs */
 static const oidToFieldFuncs *oidToFields(
 	const CssmOid			&fieldId)
 {
-	const oidToFieldFuncs *fieldTable = fieldFuncTable;
-	for(unsigned i=0; i<NUM_KNOWN_FIELDS; i++) {
-		if(fieldId == CssmData::overlay(*fieldTable->fieldId)) {
-			return fieldTable;
-		}
-		fieldTable++;
+	const oidToFieldFuncs *fieldFuncs = certFieldIndex().lookup(fieldId);
+	if(fieldFuncs != NULL) {
+		return fieldFuncs;
 	}
 #ifndef	NDEBUG
 	clErrorLog("oidToFields: unknown OID (len=%d): %s\n",
@@ -781,7 +877,7 @@ void DecodedCert::getAllParsedCertFields(
 	CSSM_FIELD_PTR 		&CertFields)			// RETURNED
 {
 	/* this is the max - some might be missing */
-	uint32 maxFields = NUM_STD_CERT_FIELDS + mDecodedExtensions.numExtensions();
+	uint32 maxFields = NUM_STD_CERT_FIELDS + decodedExtens().numExtensions();
 	CSSM_FIELD_PTR outFields = (CSSM_FIELD_PTR)mAlloc.malloc(maxFields * sizeof(CSSM_FIELD));
 
 	/*
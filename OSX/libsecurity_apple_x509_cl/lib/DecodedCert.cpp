@@ -50,7 +50,7 @@ DecodedCert::DecodedCert(
 	if(prtn) {
 		CssmError::throwMe(CSSMERR_CL_UNKNOWN_FORMAT);
 	}
-	mDecodedExtensions.decodeFromNss(mCert.tbs.extensions);
+	deferExtensions(mCert.tbs.extensions);
 	mState = IS_DecodedAll;
 }
 		
@@ -70,7 +70,7 @@ void DecodedCert::decodeTbs(
 	if(prtn) {
 		CssmError::throwMe(CSSMERR_CL_UNKNOWN_FORMAT);
 	}
-	mDecodedExtensions.decodeFromNss(mCert.tbs.extensions);
+	deferExtensions(mCert.tbs.extensions);
 	mState = IS_DecodedTBS;
 }
 
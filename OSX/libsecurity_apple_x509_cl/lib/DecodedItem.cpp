@@ -36,7 +36,8 @@ DecodedItem::DecodedItem(
 	:	mState(IS_Empty),
 		mAlloc(session),
 		mSession(session),
-		mDecodedExtensions(mCoder, session)
+		mDecodedExtensions(mCoder, session),
+		mPendingExtensions(NULL)
 {
 }
 
@@ -45,6 +46,21 @@ DecodedItem::~DecodedItem()
 	/* nothing for now */
 }
 
+/*
+ * PHASE II for items whose extensions were deferred at decode time.
+ * Cached items can be queried from several threads, hence the lock.
+ */
+void DecodedItem::decodeDeferredExtensions() const
+{
+	StLock<Mutex> _(mPendingLock);
+	if(mPendingExtensions == NULL) {
+		return;
+	}
+	NSS_CertExtension **extensions = mPendingExtensions;
+	mPendingExtensions = NULL;
+	const_cast<DecodedExtensions &>(mDecodedExtensions).decodeFromNss(extensions);
+}
+
 /* 
  * Search for DecodedExten by AsnOid or "any unknown extension".
  * Called from getField*() and inferKeyUsage. 
@@ -60,6 +76,7 @@ const DecodedExten *DecodedItem::findDecodedExt(
 	const DecodedExten *rtnExt = NULL;
 	unsigned found = 0;
 	
+	decodeDeferredExtensions();
 	for(dex=0; dex<mDecodedExtensions.numExtensions(); dex++) {
 		const DecodedExten *decodedExt = mDecodedExtensions.getExtension(dex);
 		/*
@@ -52,8 +52,9 @@
  * after PHASE I - to NSS-style C structs. This is done by examining
  * the ExtnId of each cert's or CRL's extensions and doing a BER decode
  * specific to that extension type. This is performed in 
- * DecodedExtensions.decodeFromNss() which is called immediately after
- * the top-level decode performed in PHASE I. 
+ * DecodedExtensions.decodeFromNss(). For certs this is deferred until
+ * something first asks about an extension (see deferExtensions()), so 
+ * fetching e.g. the subject or public key never decodes extensions. 
  *
  * It is at this point that a cert or CRL can be cached in the CL's 
  * cacheMap or queryMap (see AppleX509CLSession.{h,cpp}. We call this 
@@ -136,6 +137,7 @@
 #include "cldebugging.h"
 #include "DecodedExtensions.h"
 #include <security_asn1/SecNssCoder.h>
+#include <security_utilities/threading.h>
 
 /* state of a DecodedItem */
 typedef enum {
@@ -188,7 +190,7 @@ public:
 		uint32				&numFields) const;
 
 	const DecodedExtensions		&decodedExtens() const 
-		{ return mDecodedExtensions; }
+		{ decodeDeferredExtensions(); return mDecodedExtensions; }
 	
 	/* 
 	 * Common code for get extension field routines. 
@@ -219,12 +221,24 @@ public:
 	}
 
 protected:
+	/* 
+	 * Record the raw extensions of a freshly decoded item; PHASE II
+	 * runs on them the first time extensions are looked at.
+	 */
+	void deferExtensions(
+		NSS_CertExtension	**extensions)
+			{ mPendingExtensions = extensions; }
+	void decodeDeferredExtensions() const;
+
 	ItemState			mState;
 	Allocator		&mAlloc;
 	SecNssCoder			mCoder;			// from which all local allocs come
 	AppleX509CLSession	&mSession;
 	DecodedExtensions	mDecodedExtensions;
-	
+
+private:
+	mutable NSS_CertExtension	**mPendingExtensions;
+	mutable Mutex		mPendingLock;
 };
 
 
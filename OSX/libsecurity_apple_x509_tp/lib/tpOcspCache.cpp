@@ -30,8 +30,13 @@
 #include "certGroupUtils.h"
 #include <security_utilities/globalizer.h>
 #include <security_utilities/threading.h>
+#include <security_utilities/refcount.h>
 #include <security_ocspd/ocspdUtils.h>
 #include <security_utilities/simulatecrash_assert.h>
+#include <unordered_map>
+#include <map>
+#include <string>
+#include <atomic>
 
 /*
  * Set this flag nonzero to turn off this cache module. Generally used to debug
@@ -50,8 +55,12 @@
  * One cache entry, just a parsed OCSPResponse plus an optional URI and a 
  * "latest" nextUpdate time. An entry is stale when its nextUpdate time has 
  * come and gone. 
+ *
+ * An entry is indexed under the serial number of each of its SingleResponses,
+ * possibly in several shards at once, hence the reference count.
+ * sLiveEntries counts the entries not yet destroyed, for tpOcspCacheEntryCount().
  */
-class OcspCacheEntry : public OCSPResponse
+class OcspCacheEntry : public OCSPResponse, public RefCount
 {
 public:
 	OcspCacheEntry(
@@ -61,8 +70,12 @@ public:
 	
 	/* a trusting environment, this module...all public */
 	CSSM_DATA		mLocalResponder;			// we new[]
+
+	static std::atomic<unsigned> sLiveEntries;
 };
 
+std::atomic<unsigned> OcspCacheEntry::sLiveEntries(0);
+
 OcspCacheEntry::OcspCacheEntry(
 	const CSSM_DATA derEncoded,
 	const CSSM_DATA *localResponder)			// optional
@@ -77,19 +90,29 @@ OcspCacheEntry::OcspCacheEntry(
 		mLocalResponder.Data = NULL;
 		mLocalResponder.Length = 0;
 	}
+	sLiveEntries++;
 }
 
 OcspCacheEntry::~OcspCacheEntry()
 {
 	delete[] mLocalResponder.Data;
+	sLiveEntries--;
 }
 
 #pragma mark ---- global cache object ----
 
 /*
  * The cache object; ModuleNexus provides each task with at most of of these.
- * All ops which affect the contents of the cache hold the (essentially) global
- * mCacheLock.
+ *
+ * Entries are indexed by certificate serial number, the only part of a CertID
+ * which does not depend on the hash algorithm the responder used for the 
+ * issuer name and key; OCSPClientCertID::compareToExist() settles the rest.
+ * The index is split into shards by serial number, each with its own lock,
+ * so concurrent evaluations of unrelated certs don't contend. Each shard
+ * also keeps its entries in a queue ordered by expiration time, so 
+ * purging stale entries only ever looks at the ones which have expired.
+ * The index holds the only references; each index slot knows its node in
+ * the expiration queue, so flushing an entry drops both at once.
  */
 class OcspCache
 {
@@ -108,28 +131,37 @@ public:
 		OCSPClientCertID	&certID);
 
 private:
-	void removeEntry(unsigned dex);
-	void scanForStale();
-	OCSPSingleResponse *lookupPriv(
-		OCSPClientCertID	&certID,
-		const CSSM_DATA		*localResponderURI,		// optional 
-		unsigned			&rtnDex);				// RETURNED on success
+	typedef std::string SerialKey;
+	
+	/* expiration time -> (serial, entry); the entry is owned by the index */
+	typedef std::multimap<CFAbsoluteTime, std::pair<SerialKey, OcspCacheEntry *> > 
+		ExpirationQueue;
 
-	Mutex			mCacheLock;
+	struct IndexSlot {
+		RefPointer<OcspCacheEntry>			entry;
+		ExpirationQueue::iterator			expiration;
+	};
+	typedef std::unordered_multimap<SerialKey, IndexSlot> EntryIndex;
+	
+	struct Shard {
+		Mutex								lock;
+		EntryIndex							index;
+		ExpirationQueue						expirations;
+	};
+	
+	static const unsigned numShards = 16;	// power of two
 	
-	/*
-	 * NOTE: I am aware that most folks would just use an array<> here, but
-	 * gdb is so lame that it doesn't even let one examine the contents
-	 * of an array<> (or just about anything else in the STL). I prefer
-	 * debuggability over saving a few lines of trivial code.
-	 */
-	OcspCacheEntry	**mEntries;			// just an array of pointers
-	unsigned		mNumEntries;		// valid entries in mEntries
-	unsigned		mSizeofEntries;		// mallocd space in mEntries
+	static SerialKey serialKey(const CSSM_DATA &serial)
+		{ return SerialKey((const char *)serial.Data, serial.Length); }
+	Shard &shardFor(const SerialKey &serial);
+	
+	void removeEntry(Shard &shard, ExpirationQueue::iterator expiration);
+	void scanForStale(Shard &shard);
+
+	Shard			mShards[numShards];
 };
 
 OcspCache::OcspCache()
-	: mEntries(NULL), mNumEntries(0), mSizeofEntries(0)
 {
 
 }
@@ -137,69 +169,66 @@ OcspCache::OcspCache()
 /* As of Tiger I believe that this code never runs */
 OcspCache::~OcspCache()
 {
-	for(unsigned dex=0; dex<mNumEntries; dex++) {
-		delete mEntries[dex];
-	}
-	if(mEntries) {
-		free(mEntries);
-	}
+	/* entries are released with the shards' RefPointers */
+}
+
+OcspCache::Shard &OcspCache::shardFor(
+	const SerialKey &serial)
+{
+	size_t hash = std::hash<SerialKey>()(serial);
+	return mShards[hash & (numShards - 1)];
 }
 
 /* 
- * Private routine, remove entry 'n' from cache.
- * -- caller must hold mCacheLock
- * -- if caller is traversing mEntries, they must start over because we
- *    manipulate it.
+ * Private routine, remove one expiration node and the index slot which 
+ * refers to it, releasing the shard's reference to its entry.
+ * -- caller must hold shard.lock
  */
 void OcspCache::removeEntry(
-	unsigned dex)
+	Shard						&shard,
+	ExpirationQueue::iterator	expiration)
 {
-	assert(dex <= (mNumEntries - 1));
-	
-	/* removed requested element and compact remaining array */
-	delete mEntries[dex];
-	for(unsigned i=dex; i<(mNumEntries - 1); i++) {
-		mEntries[i] = mEntries[i+1];
+	std::pair<EntryIndex::iterator, EntryIndex::iterator> range = 
+		shard.index.equal_range(expiration->second.first);
+	for(EntryIndex::iterator it = range.first; it != range.second; ++it) {
+		if(it->second.expiration == expiration) {
+			shard.index.erase(it);
+			break;
+		}
 	}
-	mNumEntries--;
+	shard.expirations.erase(expiration);
 }
 
 /* 
- * Private routine to scan cache, deleting stale entries.
- * Caller must hold mCacheLock, and not be traversing mEntries.
+ * Private routine to delete the stale entries of one shard.
+ * Caller must hold shard.lock.
  */
-void OcspCache::scanForStale()
+void OcspCache::scanForStale(
+	Shard				&shard)
 {
 	CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
-	bool foundOne;
-	do {
-		/* restart every time we delete a stale entry */
-		foundOne = false;
-		for(unsigned dex=0; dex<mNumEntries; dex++) {
-			OcspCacheEntry *entry = mEntries[dex];
-			if(entry->expireTime() < now) {
-				tpOcspCacheDebug("OcspCache::scanForStale: deleting stale entry %p",
-					entry);
-				removeEntry(dex);
-				foundOne = true;
-				break;
-			}
-		}
-	} while(foundOne);
+	while(!shard.expirations.empty() && shard.expirations.begin()->first < now) {
+		tpOcspCacheDebug("OcspCache::scanForStale: deleting stale entry %p",
+			shard.expirations.begin()->second.second);
+		removeEntry(shard, shard.expirations.begin());
+	}
 }
 
-/* 
- * Private lookup routine. Caller holds mCacheLock. We return both an
- * OCSPSingleResponse and the index into mEntries at which we found it. 
- */
- OCSPSingleResponse *OcspCache::lookupPriv(
+OCSPSingleResponse *OcspCache::lookup(
 	OCSPClientCertID	&certID,
-	const CSSM_DATA		*localResponderURI,		// optional 
-	unsigned			&rtnDex)				// RETURNED on success
+	const CSSM_DATA		*localResponderURI)		// optional 
 {
-	OCSPSingleResponse *resp = NULL;
-	for(unsigned dex=0; dex<mNumEntries; dex++) {
-		OcspCacheEntry *entry = mEntries[dex];
+	SerialKey serial = serialKey(certID.subjectSerial());
+	Shard &shard = shardFor(serial);
+	StLock<Mutex> _(shard.lock);
+	
+	/* take care of stale entries right away */
+	scanForStale(shard);
+	
+	std::pair<EntryIndex::iterator, EntryIndex::iterator> range = 
+		shard.index.equal_range(serial);
+	for(EntryIndex::iterator it = range.first; it != range.second; ++it) {
+		OcspCacheEntry *entry = it->second.entry;
 		if(localResponderURI) {
 			/* if caller specifies, it must match */
 			if(entry->mLocalResponder.Data == NULL) {
@@ -214,71 +243,77 @@ void OcspCache::scanForStale()
 				continue;
 			}
 		}
-		resp = entry->singleResponseFor(certID);
+		OCSPSingleResponse *resp = entry->singleResponseFor(certID);
 		if(resp) {
-			tpOcspCacheDebug("OcspCache::lookupPriv: cache HIT on entry %p", entry);
-			rtnDex=dex;
+			tpOcspCacheDebug("OcspCache::lookup: cache HIT on entry %p", entry);
 			return resp;
 		}
 	}
-	tpOcspCacheDebug("OcspCache::lookupPriv: cache MISS");
+	tpOcspCacheDebug("OcspCache::lookup: cache MISS");
 	return NULL;
 }
 
-OCSPSingleResponse *OcspCache::lookup(
-	OCSPClientCertID	&certID,
-	const CSSM_DATA		*localResponderURI)		// optional 
-{
-	StLock<Mutex> _(mCacheLock);
-	
-	/* take care of stale entries right away */
-	scanForStale();
-	
-	unsigned rtnDex;
-	return lookupPriv(certID, localResponderURI, rtnDex);
-}
-
 void OcspCache::addResponse(
 	const CSSM_DATA		&ocspResp,				// we'll decode it
 	const CSSM_DATA		*localResponderURI)		// optional 
 {
-	StLock<Mutex> _(mCacheLock);
+	RefPointer<OcspCacheEntry> entry = new OcspCacheEntry(ocspResp, localResponderURI);
+	CFAbsoluteTime expireTime = entry->expireTime();
 
-	OcspCacheEntry *entry = new OcspCacheEntry(ocspResp, localResponderURI);
-	if(mNumEntries == mSizeofEntries) {
-		if(mSizeofEntries == 0) {
-			/* appending to empty array */
-			mSizeofEntries = 1;
+	/* index it under every serial number it has something to say about */
+	const SecAsn1OCSPResponseData &respData = entry->responseData();
+	unsigned numResponses = ocspdArraySize((const void **)respData.responses);
+	for(unsigned dex=0; dex<numResponses; dex++) {
+		SerialKey serial = serialKey(respData.responses[dex]->certID.serialNumber);
+		Shard &shard = shardFor(serial);
+		StLock<Mutex> _(shard.lock);
+		
+		std::pair<EntryIndex::iterator, EntryIndex::iterator> range = 
+			shard.index.equal_range(serial);
+		bool present = false;
+		for(EntryIndex::iterator it = range.first; it != range.second; ++it) {
+			if(it->second.entry.get() == entry.get()) {
+				present = true;		/* same serial twice in one response */
+				break;
+			}
 		}
-		else {
-			mSizeofEntries *= 2;
+		if(present) {
+			continue;
 		}
-		mEntries = (OcspCacheEntry **)realloc(mEntries, 
-			mSizeofEntries * sizeof(OcspCacheEntry *));
+		IndexSlot slot;
+		slot.entry = entry;
+		slot.expiration = shard.expirations.insert(ExpirationQueue::value_type(
+			expireTime, std::make_pair(serial, entry.get())));
+		shard.index.insert(EntryIndex::value_type(serial, slot));
 	}
-	mEntries[mNumEntries++] = entry;
-	tpOcspCacheDebug("OcspCache::addResponse: add entry %p", entry);
+	tpOcspCacheDebug("OcspCache::addResponse: add entry %p", entry.get());
 }
 
 void OcspCache::flush(
 	OCSPClientCertID	&certID)
 {
-	StLock<Mutex> _(mCacheLock);
+	SerialKey serial = serialKey(certID.subjectSerial());
+	Shard &shard = shardFor(serial);
+	StLock<Mutex> _(shard.lock);
 	
 	/* take care of all stale entries */
-	scanForStale();
+	scanForStale(shard);
 	
-	unsigned rtnDex;
-	OCSPSingleResponse *resp;
-	do {
-		/* execute as until we find no more entries matching */
-		resp = lookupPriv(certID, NULL, rtnDex);
+	std::pair<EntryIndex::iterator, EntryIndex::iterator> range = 
+		shard.index.equal_range(serial);
+	for(EntryIndex::iterator it = range.first; it != range.second; ) {
+		OCSPSingleResponse *resp = it->second.entry->singleResponseFor(certID);
 		if(resp) {
-			assert((rtnDex >= 0) && (rtnDex < mNumEntries));
-			tpOcspCacheDebug("OcspCache::flush: deleting entry %p", mEntries[rtnDex]);
-			removeEntry(rtnDex);
+			delete resp;
+			tpOcspCacheDebug("OcspCache::flush: deleting entry %p", 
+				it->second.entry.get());
+			shard.expirations.erase(it->second.expiration);
+			it = shard.index.erase(it);
 		}
-	} while(resp != NULL);
+		else {
+			++it;
+		}
+	}
 }
 
 
@@ -317,3 +352,11 @@ void tpOcspCacheFlush(
 	tpOcspCache().flush(certID);
 }
 
+/*
+ * Number of cached responses not yet destroyed, for regression tests.
+ */
+unsigned tpOcspCacheEntryCount(void)
+{
+	return OcspCacheEntry::sLiveEntries;
+}
+
@@ -57,6 +57,11 @@ void tpOcspCacheAdd(
 void tpOcspCacheFlush(
 	OCSPClientCertID	&certID);
 
+/*
+ * Number of cached responses not yet destroyed, for regression tests.
+ */
+unsigned tpOcspCacheEntryCount(void);
+
 }
 #endif	/* _TP_OCSP_CACHE_H_ */
 
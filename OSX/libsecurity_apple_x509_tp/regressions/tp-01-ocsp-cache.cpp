@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include "tp_regressions.h"
+#include "../lib/tpOcspCache.h"
+
+/* Test the TP's in-core OCSP cache: a flushed response is destroyed right
+   away, not held by its expiration node until it would have gone stale. */
+
+/*
+ * A successful BasicOCSPResponse with one SingleResponse, status good, and no
+ * nextUpdate, so it stays cached for TP_OCSP_CACHE_TTL. The CertID hashes are
+ * SHA1 of kIssuerName and kIssuerKey; the cache never checks the signature.
+ */
+static const uint8 kOcspResponse[] = {
+    0x30, 0x81, 0xba, 0x0a, 0x01, 0x00, 0xa0, 0x81, 0xb4, 0x30, 0x81, 0xb1,
+    0x06, 0x09, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07, 0x30, 0x01, 0x01, 0x04,
+    0x81, 0xa3, 0x30, 0x81, 0xa0, 0x30, 0x7c, 0xa2, 0x16, 0x04, 0x14, 0xf4,
+    0xa1, 0xb4, 0xb6, 0xea, 0xa4, 0x60, 0x8f, 0xb7, 0x4e, 0x1f, 0x80, 0xcc,
+    0x21, 0xd3, 0xfd, 0xd6, 0x47, 0x9b, 0xb0, 0x18, 0x0f, 0x32, 0x30, 0x31,
+    0x34, 0x30, 0x38, 0x32, 0x30, 0x32, 0x31, 0x31, 0x33, 0x30, 0x37, 0x5a,
+    0x30, 0x51, 0x30, 0x4f, 0x30, 0x3a, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e,
+    0x03, 0x02, 0x1a, 0x05, 0x00, 0x04, 0x14, 0x61, 0x73, 0x7c, 0x8d, 0xf9,
+    0xbd, 0xaf, 0x6f, 0xb8, 0x13, 0xd0, 0x04, 0x11, 0xd1, 0x1a, 0x45, 0x8c,
+    0xa6, 0x50, 0x05, 0x04, 0x14, 0xf4, 0xa1, 0xb4, 0xb6, 0xea, 0xa4, 0x60,
+    0x8f, 0xb7, 0x4e, 0x1f, 0x80, 0xcc, 0x21, 0xd3, 0xfd, 0xd6, 0x47, 0x9b,
+    0xb0, 0x02, 0x01, 0x2a, 0x80, 0x00, 0x18, 0x0f, 0x32, 0x30, 0x31, 0x34,
+    0x30, 0x38, 0x32, 0x30, 0x32, 0x31, 0x31, 0x33, 0x30, 0x37, 0x5a, 0x30,
+    0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x05,
+    0x05, 0x00, 0x03, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const char kIssuerName[] = "tp-01 issuer name";
+static const char kIssuerKey[] = "tp-01 issuer key";
+static const uint8 kSerial[] = { 0x2a };
+static const uint8 kOtherSerial[] = { 0x2b };
+
+static const CSSM_DATA issuerName = { sizeof(kIssuerName) - 1, (uint8 *)kIssuerName };
+static const CSSM_DATA issuerKey = { sizeof(kIssuerKey) - 1, (uint8 *)kIssuerKey };
+
+static bool cached(OCSPClientCertID &certID) {
+    OCSPSingleResponse *resp = tpOcspCacheLookup(certID, NULL);
+    delete resp;
+    return resp != NULL;
+}
+
+static void tests(void) {
+    CSSM_DATA response = { sizeof(kOcspResponse), (uint8 *)kOcspResponse };
+    CSSM_DATA serial = { sizeof(kSerial), (uint8 *)kSerial };
+    CSSM_DATA otherSerial = { sizeof(kOtherSerial), (uint8 *)kOtherSerial };
+    OCSPClientCertID certID(issuerName, issuerKey, serial);
+    OCSPClientCertID otherCertID(issuerName, issuerKey, otherSerial);
+    unsigned baseCount = tpOcspCacheEntryCount();
+
+    tpOcspCacheAdd(response, NULL);
+    is(tpOcspCacheEntryCount(), baseCount + 1, "add caches one entry");
+    ok(cached(certID), "lookup hits");
+    ok(!cached(otherCertID), "lookup of another serial misses");
+
+    tpOcspCacheFlush(otherCertID);
+    is(tpOcspCacheEntryCount(), baseCount + 1, "flush of another serial keeps the entry");
+    ok(cached(certID), "lookup still hits");
+
+    tpOcspCacheFlush(certID);
+    ok(!cached(certID), "lookup misses after flush");
+    is(tpOcspCacheEntryCount(), baseCount, "flush destroys the entry");
+
+    /* a second add after a flush starts over */
+    tpOcspCacheAdd(response, NULL);
+    is(tpOcspCacheEntryCount(), baseCount + 1, "re-add caches one entry");
+    tpOcspCacheFlush(certID);
+    is(tpOcspCacheEntryCount(), baseCount, "second flush destroys it too");
+}
+
+int tp_01_ocsp_cache(int argc, char *const *argv) {
+    plan_tests(9);
+
+    tests();
+
+    return 0;
+}
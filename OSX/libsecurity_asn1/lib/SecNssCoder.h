@@ -135,6 +135,18 @@ public:
 		
 	PLArenaPool	*pool() const { return mPool;}
 	
+	/*
+	 * Arena chunks freed by a coder are recycled through a per-thread
+	 * cache shared by all coders (see PL_SetArenaCacheLimit()). These
+	 * report its counters and adjust its per-thread high-water mark.
+	 */
+	static void cacheStatistics(
+		PLArenaCacheStats		&stats)
+			{ PL_GetArenaCacheStats(&stats); }
+	static void setCacheLimit(
+		PRUint32				bytes)
+			{ PL_SetArenaCacheLimit(bytes); }
+	
 private:
 	PLArenaPool		*mPool;
 
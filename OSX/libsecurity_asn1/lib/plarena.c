@@ -61,6 +61,8 @@
 #include "plarena.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "prbit.h"
 #include "prinit.h"
 #include "prlog.h"
@@ -76,6 +78,196 @@ static PLArenaStats* arena_stats_list;
 
 #define PL_ARENA_DEFAULT_ALIGN sizeof(double)
 
+/*
+ * Per-thread arena cache.
+ *
+ * Cacheable arenas are allocated with a net size rounded up to a power of
+ * two between 1K and PL_ARENA_CACHE_MAX, plus the arena
+ * header and a fixed alignment slop, so the class of an arena can be
+ * recovered from its total size alone when it is freed. Arenas from pools
+ * with a larger alignment, or bigger than the largest class, bypass the
+ * cache entirely.
+ */
+#define PL_ARENA_CACHE_MIN_SHIFT    10      /* 1K */
+#define PL_ARENA_CACHE_CLASSES      6       /* 1K .. 32K */
+#define PL_ARENA_CACHE_MAX          (1U << (PL_ARENA_CACHE_MIN_SHIFT + PL_ARENA_CACHE_CLASSES - 1))
+#define PL_ARENA_CACHE_SLOP         15      /* covers alignments up to 16 */
+#define PL_ARENA_CACHE_LIMIT_DEF    (256 * 1024)
+
+typedef struct PLArenaCache {
+    PLArena     *free[PL_ARENA_CACHE_CLASSES];
+    PRUint32    bytes;          /* total size of all cached arenas */
+} PLArenaCache;
+
+static pthread_once_t arena_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t arena_cache_key;
+static int arena_cache_key_valid;
+static _Atomic(PRUint32) arena_cache_limit = PL_ARENA_CACHE_LIMIT_DEF;
+
+static _Atomic(PRUint64) arena_cache_hits;
+static _Atomic(PRUint64) arena_cache_misses;
+static _Atomic(PRUint64) arena_cache_recycled;
+static _Atomic(PRUint64) arena_cache_discarded;
+
+#define CACHE_COUNT(what) atomic_fetch_add_explicit(&arena_cache_##what, 1, memory_order_relaxed)
+
+static void ArenaCacheDrain(PLArenaCache* cache)
+{
+    int c;
+
+    for (c = 0; c < PL_ARENA_CACHE_CLASSES; c++) {
+        PLArena* a;
+        while ((a = cache->free[c]) != NULL) {
+            cache->free[c] = a->next;
+            PR_DELETE(a);
+        }
+    }
+    cache->bytes = 0;
+}
+
+static void ArenaCacheDestroy(void* context)
+{
+    PLArenaCache* cache = (PLArenaCache*)context;
+
+    ArenaCacheDrain(cache);
+    free(cache);
+}
+
+static void ArenaCacheInit(void)
+{
+    arena_cache_key_valid = (pthread_key_create(&arena_cache_key, ArenaCacheDestroy) == 0);
+}
+
+static PLArenaCache* ArenaCacheGet(PRBool create)
+{
+    PLArenaCache* cache;
+
+    pthread_once(&arena_cache_once, ArenaCacheInit);
+    if (!arena_cache_key_valid) {
+        return NULL;
+    }
+    cache = (PLArenaCache*)pthread_getspecific(arena_cache_key);
+    if (cache == NULL && create) {
+        cache = (PLArenaCache*)calloc(1, sizeof(*cache));
+        if (cache != NULL && pthread_setspecific(arena_cache_key, cache) != 0) {
+            free(cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+/* Size class for a net arena size, or -1 if it is not cacheable. */
+static int ArenaCacheClassForSize(PRUint32 net)
+{
+    int c;
+
+    if (net > PL_ARENA_CACHE_MAX) {
+        return -1;
+    }
+    for (c = 0; c < PL_ARENA_CACHE_CLASSES; c++) {
+        if (net <= (1U << (PL_ARENA_CACHE_MIN_SHIFT + c))) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+static PRUword ArenaCacheTotalSize(int c)
+{
+    return sizeof(PLArena) + PL_ARENA_CACHE_SLOP + (1U << (PL_ARENA_CACHE_MIN_SHIFT + c));
+}
+
+/* Size class of an existing arena, or -1 if it was not allocated by the cache. */
+static int ArenaCacheClassOfArena(PLArena* a)
+{
+    PRUword total = a->limit - (PRUword)a;
+    int c;
+
+    for (c = 0; c < PL_ARENA_CACHE_CLASSES; c++) {
+        if (total == ArenaCacheTotalSize(c)) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Allocate a raw arena able to hold at least net bytes after alignment.
+ * On return *total is the full size of the block, header included.
+ */
+static PLArena* ArenaNew(PLArenaPool* pool, PRUint32 net, PRUword* total)
+{
+    PLArena* a;
+    int c = -1;
+
+    if (pool->mask <= PL_ARENA_CACHE_SLOP) {
+        c = ArenaCacheClassForSize(net);
+    }
+    if (c < 0) {
+        PRUint32 sz = net;
+        if (PR_UINT32_MAX - sz < sizeof *a + pool->mask) {
+            return NULL;
+        }
+        sz += sizeof *a + pool->mask; /* header and alignment slop */
+        *total = sz;
+        return (PLArena*)PR_MALLOC(sz);
+    }
+
+    *total = ArenaCacheTotalSize(c);
+    PLArenaCache* cache = ArenaCacheGet(PR_FALSE);
+    if (cache != NULL && (a = cache->free[c]) != NULL) {
+        cache->free[c] = a->next;
+        cache->bytes -= *total;
+        CACHE_COUNT(hits);
+        return a;
+    }
+    CACHE_COUNT(misses);
+    return (PLArena*)PR_MALLOC(*total);
+}
+
+/*
+ * Return an arena that is no longer linked into any pool. Pools routinely
+ * hold decoded key material, so the whole body is zeroed up to limit (a
+ * released mark can leave data past avail) before the arena is kept for
+ * reuse, if this thread is under its limit, or freed.
+ */
+static void ArenaDelete(PLArena* a)
+{
+    int c = ArenaCacheClassOfArena(a);
+
+    rsize_t body = a->limit - (PRUword)(a + 1);
+    memset_s((void*)(a + 1), body, 0, body); /* not elided ahead of free() */
+    if (c >= 0) {
+        PRUword total = ArenaCacheTotalSize(c);
+        PRUint32 limit = atomic_load_explicit(&arena_cache_limit, memory_order_relaxed);
+        PLArenaCache* cache = limit ? ArenaCacheGet(PR_TRUE) : NULL;
+        if (cache != NULL && cache->bytes + total <= limit) {
+            a->next = cache->free[c];
+            cache->free[c] = a;
+            cache->bytes += total;
+            CACHE_COUNT(recycled);
+            return;
+        }
+        CACHE_COUNT(discarded);
+    }
+    PL_CLEAR_ARENA(a);
+    PR_DELETE(a);
+}
+
+PR_IMPLEMENT(void) PL_SetArenaCacheLimit(PRUint32 bytes)
+{
+    atomic_store_explicit(&arena_cache_limit, bytes, memory_order_relaxed);
+}
+
+PR_IMPLEMENT(void) PL_GetArenaCacheStats(PLArenaCacheStats* stats)
+{
+    stats->hits = atomic_load_explicit(&arena_cache_hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&arena_cache_misses, memory_order_relaxed);
+    stats->recycled = atomic_load_explicit(&arena_cache_recycled, memory_order_relaxed);
+    stats->discarded = atomic_load_explicit(&arena_cache_discarded, memory_order_relaxed);
+}
+
 PR_IMPLEMENT(void)
 PL_InitArenaPool(PLArenaPool* pool, const char* name, PRUint32 size, PRUint32 align)
 {
@@ -152,19 +344,14 @@ PR_IMPLEMENT(void*) PL_ArenaAllocate(PLArenaPool* pool, PRUint32 nb)
         } while (NULL != (a = a->next));
     }
 
-    /* attempt to allocate from the heap */
+    /* attempt to allocate from the heap (or this thread's arena cache) */
     {
-        PRUint32 sz = PR_MAX(pool->arenasize, nb);
-        if (PR_UINT32_MAX - sz < sizeof *a + pool->mask) {
-            a = NULL;
-        } else {
-            sz += sizeof *a + pool->mask; /* header and alignment slop */
-            a = (PLArena*)PR_MALLOC(sz);
-        }
+        PRUword sz = 0;
+        a = ArenaNew(pool, PR_MAX(pool->arenasize, nb), &sz);
 #ifdef __APPLE__
         // Check for integer overflow on a->avail += nb
         PRUword a_avail_tmp = (PRUword)PL_ARENA_ALIGN(pool, a + 1);
-        if (a_avail_tmp + nb < a_avail_tmp) {
+        if (a && a_avail_tmp + nb < a_avail_tmp) {
             PR_FREEIF(a);  // Set a back to NULL
         }
 #endif
@@ -259,9 +446,8 @@ PL_ArenaGrow(PLArenaPool* pool, void* p, PRUint32 origSize, PRUint32 incr)
                 lastArena->next = thisArena->next;
 
                 /* and free */
-                PL_CLEAR_ARENA(thisArena);
                 PL_COUNT_ARENA(pool, --);
-                PR_DELETE(thisArena);
+                ArenaDelete(thisArena);
                 break;
             }
         }
@@ -305,9 +491,8 @@ static void FreeArenaList(PLArenaPool* pool, PLArena* head, PRBool reallyFree)
 
     do {
         *ap = a->next;
-        PL_CLEAR_ARENA(a);
         PL_COUNT_ARENA(pool, --);
-        PR_DELETE(a);
+        ArenaDelete(a);
     } while ((a = *ap) != 0);
 
     pool->current = head;
@@ -355,7 +540,14 @@ PR_IMPLEMENT(void) PL_FinishArenaPool(PLArenaPool* pool)
 
 PR_IMPLEMENT(void) PL_CompactArenaPool(PLArenaPool* ap) {}
 
-PR_IMPLEMENT(void) PL_ArenaFinish(void) {}
+PR_IMPLEMENT(void) PL_ArenaFinish(void)
+{
+    PLArenaCache* cache = ArenaCacheGet(PR_FALSE);
+
+    if (cache != NULL) {
+        ArenaCacheDrain(cache);
+    }
+}
 
 #ifdef PL_ARENAMETER
 PR_IMPLEMENT(void) PL_ArenaCountAllocation(PLArenaPool* pool, PRUint32 nb)
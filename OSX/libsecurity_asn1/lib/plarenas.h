@@ -119,6 +119,31 @@ PR_EXTERN(void) PL_ArenaRelease(PLArenaPool *pool, char *mark);
  */
 PR_EXTERN(void) PL_ClearArenaPool(PLArenaPool *pool, PRInt32 pattern);
 
+/*
+** Arenas whose size falls in one of the cache's size classes are not handed
+** back to malloc when a pool is freed; they are zeroed and kept on a
+** per-thread free list for the next pool to reuse, up to a per-thread
+** high-water mark of cached bytes.
+*/
+typedef struct PLArenaCacheStats {
+    PRUint64    hits;           /* arenas satisfied from a thread cache */
+    PRUint64    misses;         /* cacheable arenas that had to be malloced */
+    PRUint64    recycled;       /* arenas returned to a thread cache */
+    PRUint64    discarded;      /* arenas freed because a cache was full */
+} PLArenaCacheStats;
+
+/*
+** Set the maximum number of bytes each thread may keep cached. Zero
+** disables caching; arenas already cached are drained as threads exit or
+** call PL_ArenaFinish().
+*/
+PR_EXTERN(void) PL_SetArenaCacheLimit(PRUint32 bytes);
+
+/*
+** Snapshot of the process-wide arena cache counters.
+*/
+PR_EXTERN(void) PL_GetArenaCacheStats(PLArenaCacheStats *stats);
+
 PR_END_EXTERN_C
 
 #endif /* defined(PLARENAS_H) */
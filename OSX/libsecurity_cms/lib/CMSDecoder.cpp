@@ -71,6 +71,8 @@ struct _CMSDecoder {
 	SecCmsDecoderRef	decoder;
 	CFDataRef			detachedContent;
 	CFTypeRef			keychainOrArray;	/* unused */
+	SecCmsContentCallback contentCallback;	/* optional, see CMSDecoderSetContentCallback */
+	void				*contentCallbackArg;
 	
 	/*
 	 * The following are valid (and quiescent) after CMSDecoderFinalizeMessage().
@@ -242,7 +244,8 @@ OSStatus CMSDecoderUpdateMessage(
 				return cmsRtnToOSStatus(ortn);
 			}
 			ortn = SecCmsDecoderCreate(cmsDecoder->arena,
-                                       NULL, NULL, NULL, NULL, NULL, NULL, &cmsDecoder->decoder);
+                                       cmsDecoder->contentCallback, cmsDecoder->contentCallbackArg,
+                                       NULL, NULL, NULL, NULL, &cmsDecoder->decoder);
 			if(ortn) {
 				ortn = cmsRtnToOSStatus(ortn);
 				CSSM_PERROR("SecCmsDecoderCreate", ortn);
@@ -810,6 +813,26 @@ OSStatus CMSDecoderSetDecoder(
 	return errSecSuccess;
 }
 
+/*
+ * Stream encapsulated content to a callback instead of buffering it.
+ * Must be called before the first call to CMSDecoderUpdateMessage().
+ */
+OSStatus CMSDecoderSetContentCallback(
+                                      CMSDecoderRef			cmsDecoder,
+                                      SecCmsContentCallback	callback,
+                                      void					*callbackArg)
+{
+	if((cmsDecoder == NULL) || (callback == NULL)) {
+		return errSecParam;
+	}
+	if(cmsDecoder->decState != DS_Init) {
+		return errSecParam;
+	}
+	cmsDecoder->contentCallback = callback;
+	cmsDecoder->contentCallbackArg = callbackArg;
+	return errSecSuccess;
+}
+
 /*
  * Obtain the SecCmsDecoderRef associated with a CMSDecoderRef.
  * Returns a NULL SecCmsDecoderRef if neither CMSDecoderSetDecoder() nor
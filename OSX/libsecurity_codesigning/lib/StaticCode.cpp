@@ -42,6 +42,7 @@
 #if TARGET_OS_OSX
 #include "csdatabase.h"
 #endif
+#include "validationcache.h"
 #include "dirscanner.h"
 #include <CoreFoundation/CFURLAccess.h>
 #include <Security/SecPolicyPriv.h>
@@ -65,6 +66,7 @@
 #include <dirent.h>
 #include <sys/xattr.h>
 #include <sstream>
+#include <memory>
 #include <IOKit/storage/IOStorageDeviceCharacteristics.h>
 #include <dispatch/private.h>
 #include <os/assumes.h>
@@ -94,6 +96,22 @@ static const char developerID[] = "anchor apple generic and certificate 1[field.
 static const char distributionCertificate[] =	"anchor apple generic and certificate leaf[field.1.2.840.113635.100.6.1.7] exists";
 static const char iPhoneDistributionCert[] =	"anchor apple generic and certificate leaf[field.1.2.840.113635.100.6.1.4] exists";
 
+//
+// Resource validation hands files to its workers in batches. Files of up to
+// kResourceBatchFileSize bytes share a batch until it holds kResourceBatchCount
+// files or kResourceBatchBytes bytes; larger files and directories (nested code)
+// are dispatched on their own.
+//
+static const off_t kResourceBatchFileSize = 64 * 1024;
+static const size_t kResourceBatchCount = 64;
+static const off_t kResourceBatchBytes = 1024 * 1024;
+
+struct ResourceBatchItem {
+	std::string relpath;
+	bool isSymlink;
+};
+typedef std::vector<ResourceBatchItem> ResourceBatch;
+
 //
 // Map a component slot number to a suitable error code for a failure
 //
@@ -265,6 +283,17 @@ void SecStaticCode::reportProgress(unsigned amount /* = 1 */)
 	}
 }
 
+void SecStaticCode::reportThroughput(unsigned files, off_t bytes, CFAbsoluteTime seconds)
+{
+	if (mMonitor && (mValidationFlags & kSecCSReportProgress)) {
+		// aggregate resource validation rate, reported once the walk is done
+		CFTempNumber byteCount((long long)bytes);
+		CFTempNumber elapsed(double(seconds));
+		mMonitor(this->handle(false), CFSTR("throughput"),
+			CFTemp<CFDictionaryRef>("{files=%u,bytes=%O,seconds=%O}", files, byteCount.get(), elapsed.get()));
+	}
+}
+
 
 //
 // Set validation conditions for fine-tuning legacy tolerance
@@ -1283,26 +1312,60 @@ void SecStaticCode::validateExecutable()
 				// If the signing base is non-zero, we need to seek forward.
 				fd.seek(mRep->signingBase());
 			}
+			bool validatePEH = mValidationFlags & kSecCSValidatePEH;
+			ValidationCache::Key cacheKey(this->cdHash(), fd, validatePEH ? kSecCSValidatePEH : 0);
+			if (validationCache().find(cacheKey)) {
+				// this very file already passed this check, and hasn't changed since
+				mExecutableValidated = true;
+				mExecutableValidResult = errSecSuccess;
+				return;
+			}
 			size_t pageSize = cd->pageSize ? (1 << cd->pageSize) : 0;
 			size_t remaining = cd->signingLimit();
-			for (uint32_t slot = 0; slot < cd->nCodeSlots; ++slot) {
-				size_t thisPage = remaining;
-				if (pageSize)
-					thisPage = min(thisPage, pageSize);
-				__block bool good = true;
-				CodeDirectory::multipleHashFileData(fd, thisPage, hashAlgorithms(), ^(CodeDirectory::HashAlgorithm type, Security::DynamicHash *hasher) {
-					const CodeDirectory* cd = (const CodeDirectory*)CFDataGetBytePtr(mCodeDirectories[type]);
-					if (!hasher->verify(cd->getSlot(slot,
-													mValidationFlags & kSecCSValidatePEH)))
-						good = false;
-				});
-				if (!good) {
-					CODESIGN_EVAL_STATIC_EXECUTABLE_FAIL(this, (int)slot);
-					MacOSError::throwMe(errSecCSSignatureFailed);
+			if (pageSize) {
+				// read a chunk of pages at a time and hash its pages in parallel, for each hash type
+				size_t chunkPages = max(size_t(1), CodeDirectory::pageHashChunkSize / pageSize);
+				vector<Hashing::Byte> buffer(min(remaining, chunkPages * pageSize));
+				for (uint32_t slot = 0; slot < cd->nCodeSlots; ) {
+					uint32_t pages = uint32_t(min(chunkPages, size_t(cd->nCodeSlots - slot)));
+					size_t thisChunk = min(remaining, pages * pageSize);
+					size_t length = fd.readAll(buffer.data(), thisChunk);
+					CodeDirectory::HashAlgorithms types = hashAlgorithms();
+					for (auto type = types.begin(); type != types.end(); ++type) {
+						if (!CodeDirectory::viableHash(*type))
+							continue;
+						const CodeDirectory* typeCD = (const CodeDirectory*)CFDataGetBytePtr(mCodeDirectories[*type]);
+						size_t digestLength = typeCD->hashSize;
+						vector<Hashing::Byte> digests(pages * digestLength);
+						CodeDirectory::hashPages(*type, buffer.data(), length, pageSize, pages, digests.data());
+						for (uint32_t page = 0; page < pages; ++page) {
+							if (memcmp(&digests[page * digestLength], typeCD->getSlot(slot + page, validatePEH), digestLength)) {
+								CODESIGN_EVAL_STATIC_EXECUTABLE_FAIL(this, (int)(slot + page));
+								MacOSError::throwMe(errSecCSSignatureFailed);
+							}
+						}
+					}
+					remaining -= thisChunk;
+					slot += pages;
+				}
+			} else {
+				for (uint32_t slot = 0; slot < cd->nCodeSlots; ++slot) {
+					size_t thisPage = remaining;
+					__block bool good = true;
+					CodeDirectory::multipleHashFileData(fd, thisPage, hashAlgorithms(), ^(CodeDirectory::HashAlgorithm type, Security::DynamicHash *hasher) {
+						const CodeDirectory* cd = (const CodeDirectory*)CFDataGetBytePtr(mCodeDirectories[type]);
+						if (!hasher->verify(cd->getSlot(slot, validatePEH)))
+							good = false;
+					});
+					if (!good) {
+						CODESIGN_EVAL_STATIC_EXECUTABLE_FAIL(this, (int)slot);
+						MacOSError::throwMe(errSecCSSignatureFailed);
+					}
+					remaining -= thisPage;
 				}
-				remaining -= thisPage;
 			}
 			assert(remaining == 0);
+			validationCache().insert(cacheKey);
 			mExecutableValidated = true;
 			mExecutableValidResult = errSecSuccess;
 		} catch (const CommonError &err) {
@@ -1451,40 +1514,75 @@ void SecStaticCode::validateResources(SecCSFlags flags)
 				};
 			}
 
-			void (^validationScanner)(FTSENT *, uint32_t , const string, ResourceBuilder::Rule *) = ^(FTSENT *ent, uint32_t ruleFlags, const string relpath, ResourceBuilder::Rule *rule) {
-				CFDictionaryRemoveValue(resourceMap, CFTempString(relpath));
-				bool isSymlink = (ent->fts_info == FTS_SL);
+			void (^validateItem)(const string &, bool) = ^(const string &relpath, bool isSymlink) {
+				bool needsValidation = true;
 
-				void (^validate)() = ^{
-					bool needsValidation = true;
+				if (skipXattrFiles && pathIsValidXattrFile(cfString(resourceBase()) + "/" + relpath, "staticCode")) {
+					secinfo("staticCode", "resource validation on xattr file skipped: %s", relpath.c_str());
+					needsValidation = false;
+				}
 
-					if (skipXattrFiles && pathIsValidXattrFile(cfString(resourceBase()) + "/" + relpath, "staticCode")) {
-						secinfo("staticCode", "resource validation on xattr file skipped: %s", relpath.c_str());
+				if (useRootFSPolicy) {
+					CFRef<CFURLRef> itemURL = makeCFURL(relpath, false, resourceBase());
+					string itemPath = cfString(itemURL);
+					if (itemQualifiesForResourceExemption(itemPath)) {
+						secinfo("staticCode", "resource validation on root volume skipped: %s", itemPath.c_str());
 						needsValidation = false;
 					}
+				}
 
-					if (useRootFSPolicy) {
-						CFRef<CFURLRef> itemURL = makeCFURL(relpath, false, resourceBase());
-						string itemPath = cfString(itemURL);
-						if (itemQualifiesForResourceExemption(itemPath)) {
-							secinfo("staticCode", "resource validation on root volume skipped: %s", itemPath.c_str());
-							needsValidation = false;
-						}
-					}
+				if (needsValidation) {
+					secinfo("staticCode", "performing resource validation on item: %s", relpath.c_str());
+					validateResource(files, relpath, isSymlink, *mResourcesValidContext, flags, version);
+				}
+			};
 
-					if (needsValidation) {
-						secinfo("staticCode", "performing resource validation on item: %s", relpath.c_str());
-						validateResource(files, relpath, isSymlink, *mResourcesValidContext, flags, version);
-					}
-					reportProgress();
-				};
+			// The scanner only enumerates; reading and hashing happen in the batches
+			// it hands to mLimitedAsync, which bounds how many run (and read) at once.
+			void (^dispatchBatch)(std::shared_ptr<ResourceBatch>) = ^(std::shared_ptr<ResourceBatch> work) {
+				mLimitedAsync->perform(groupRef, ^{
+					for (ResourceBatch::const_iterator it = work->begin(); it != work->end(); ++it)
+						validateItem(it->relpath, it->isSymlink);
+					reportProgress(unsigned(work->size()));
+				});
+			};
 
-				mLimitedAsync->perform(groupRef, validate);
+			__block std::shared_ptr<ResourceBatch> batch = std::make_shared<ResourceBatch>();
+			__block off_t batchBytes = 0;
+			__block unsigned scannedFiles = 0;
+			__block off_t scannedBytes = 0;
+			CFAbsoluteTime scanStart = CFAbsoluteTimeGetCurrent();
+
+			void (^validationScanner)(FTSENT *, uint32_t , const string, ResourceBuilder::Rule *) = ^(FTSENT *ent, uint32_t ruleFlags, const string relpath, ResourceBuilder::Rule *rule) {
+				CFDictionaryRemoveValue(resourceMap, CFTempString(relpath));
+				bool isSymlink = (ent->fts_info == FTS_SL);
+				off_t size = (ent->fts_info == FTS_F && ent->fts_statp) ? ent->fts_statp->st_size : 0;
+				scannedFiles++;
+				scannedBytes += size;
+
+				ResourceBatchItem item = { relpath, isSymlink };
+				if (ent->fts_info == FTS_D || size > kResourceBatchFileSize) {
+					std::shared_ptr<ResourceBatch> single = std::make_shared<ResourceBatch>(1, item);
+					dispatchBatch(single);
+					return;
+				}
+
+				batch->push_back(item);
+				batchBytes += size;
+				if (batch->size() >= kResourceBatchCount || batchBytes >= kResourceBatchBytes) {
+					dispatchBatch(batch);
+					batch = std::make_shared<ResourceBatch>();
+					batchBytes = 0;
+				}
 			};
 
 			resources.scan(validationScanner, unhandledScanner);
+			if (!batch->empty())
+				dispatchBatch(batch);
 			group.wait();	// wait until all async resources have been validated as well
 
+			reportThroughput(scannedFiles, scannedBytes, CFAbsoluteTimeGetCurrent() - scanStart);
+
 			if (useRootFSPolicy) {
 				// It's ok to allow leftovers on the root filesystem for now.
 			} else {
@@ -157,6 +157,7 @@ public:
 	void setMonitor(SecCodeCallback monitor) { mMonitor = monitor; }
 	CFTypeRef reportEvent(CFStringRef stage, CFDictionaryRef info);
 	void reportProgress(unsigned amount = 1);
+	void reportThroughput(unsigned files, off_t bytes, CFAbsoluteTime seconds);
 
 	SecCSFlags getFlags() { return mFlags; }
 	void setFlags(SecCSFlags flags) { mFlags = flags; }
@@ -27,6 +27,7 @@
 #include "cdbuilder.h"
 #include <security_utilities/memutils.h>
 #include <cmath>
+#include <vector>
 
 using namespace UnixPlusPlus;
 using LowLevelMemoryUtilities::alignUp;
@@ -292,17 +293,28 @@ CodeDirectory *CodeDirectory::Builder::build()
 	// fill code slots
 	mExec.seek(mExecOffset);
 	size_t remaining = mExecLength;
-	for (unsigned int slot = 0; slot < mCodeSlots; ++slot) {
-		size_t thisPage = remaining;
-		if (mPageSize)
-			thisPage = min(thisPage, mPageSize);
-		MakeHash<Builder> hasher(this);
-		generateHash(hasher, mExec, mDir->getSlotMutable(slot, false), thisPage);
-		if (mGeneratePreEncryptHashes && mPreservedPreEncryptHashMap.empty()) {
-			memcpy(mDir->getSlotMutable(slot, true), mDir->getSlot(slot, false),
-				   mDir->hashSize);
+	if (mPageSize) {
+		// read a chunk of pages at a time and hash its pages in parallel
+		size_t chunkPages = max(size_t(1), pageHashChunkSize / mPageSize);
+		vector<Hashing::Byte> buffer(min(remaining, chunkPages * mPageSize));
+		for (unsigned int slot = 0; slot < mCodeSlots; ) {
+			size_t pages = min(chunkPages, size_t(mCodeSlots - slot));
+			size_t thisChunk = min(remaining, pages * mPageSize);
+			size_t length = mExec.readAll(buffer.data(), thisChunk);
+			hashPages(mHashType, buffer.data(), length, mPageSize, pages, mDir->getSlotMutable(slot, false));
+			remaining -= thisChunk;
+			slot += pages;
+		}
+	} else {
+		for (unsigned int slot = 0; slot < mCodeSlots; ++slot) {
+			MakeHash<Builder> hasher(this);
+			generateHash(hasher, mExec, mDir->getSlotMutable(slot, false), remaining);
+			remaining = 0;
 		}
-		remaining -= thisPage;
+	}
+	if (mGeneratePreEncryptHashes && mPreservedPreEncryptHashMap.empty() && mCodeSlots > 0) {
+		memcpy(mDir->getSlotMutable(0, true), mDir->getSlot(0, false),
+			   mCodeSlots * mDir->hashSize);
 	}
 	assert(remaining == 0);
 
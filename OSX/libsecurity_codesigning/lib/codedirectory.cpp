@@ -327,6 +327,17 @@ void CodeDirectory::multipleHashFileData(FileDesc fd, size_t limit, CodeDirector
 		action(it->first, it->second);
 	}
 }
+
+
+//
+// Hash pageCount pages of code in memory into consecutive (type) digests.
+// See Security::hashPages().
+//
+void CodeDirectory::hashPages(HashAlgorithm type, const void *data, size_t length, size_t pageSize, size_t pageCount, Hashing::Byte *digests)
+{
+	RefPointer<DynamicHash> hasher = hashFor(type);
+	Security::hashPages(^{ return hashFor(type); }, hasher->digestLength(), data, length, pageSize, pageCount, digests);
+}
     
     
     //
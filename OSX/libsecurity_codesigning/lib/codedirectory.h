@@ -305,6 +305,8 @@ public:
 	CFDataRef cdhash(bool truncate = true) const;
 	
 	static void multipleHashFileData(UnixPlusPlus::FileDesc fd, size_t limit, HashAlgorithms types, void (^action)(HashAlgorithm type, DynamicHash* hasher));
+	static void hashPages(HashAlgorithm type, const void *data, size_t length, size_t pageSize, size_t pageCount, Hashing::Byte *digests);
+	static const size_t pageHashChunkSize = 4 * 1024 * 1024;	// how much code to read at a time for hashPages()
     bool verifyMemoryContent(CFDataRef data, const Byte* digest) const;
 
 	static bool viableHash(HashAlgorithm type);
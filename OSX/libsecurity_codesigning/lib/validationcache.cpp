@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+//
+// validationcache - in-process record of successfully validated main executables
+//
+#include "validationcache.h"
+#include <security_utilities/hashing.h>
+#include <security_utilities/debugging.h>
+
+namespace Security {
+namespace CodeSigning {
+
+using namespace UnixPlusPlus;
+
+
+ModuleNexus<ValidationCache> validationCache;
+
+static const uint32_t cacheEntries = 4096;		// must be a power of two
+
+
+struct ValidationCache::Entry {
+	Key key;
+	bool valid;
+};
+
+
+//
+// Form the key for the file open at fd
+//
+ValidationCache::Key::Key(CFDataRef hash, FileDesc fd, uint32_t validationFlags)
+{
+	memset(this, 0, sizeof(*this));		// no stray padding bytes in comparisons or hashes
+	if (hash)
+		memcpy(cdhash, CFDataGetBytePtr(hash), min(sizeof(cdhash), size_t(CFDataGetLength(hash))));
+	flags = validationFlags;
+
+	FileDesc::UnixStat st;
+	fd.fstat(st);
+	device = st.st_dev;
+	inode = st.st_ino;
+	size = st.st_size;
+	mtime[0] = st.st_mtimespec.tv_sec;
+	mtime[1] = st.st_mtimespec.tv_nsec;
+	ctime[0] = st.st_ctimespec.tv_sec;
+	ctime[1] = st.st_ctimespec.tv_nsec;
+}
+
+
+//
+// Allocate the (empty) table.
+// Failure leaves the cache disabled rather than failing validation.
+//
+ValidationCache::ValidationCache()
+	: mEntries(NULL), mHits(0), mMisses(0)
+{
+	mEntries = (Entry *)::calloc(cacheEntries, sizeof(Entry));
+	if (!mEntries)
+		secinfo("validationcache", "cannot allocate cache; cache disabled");
+}
+
+ValidationCache::~ValidationCache()
+{
+	::free(mEntries);
+}
+
+
+//
+// Direct-mapped lookup: each key has exactly one slot it can live in
+//
+ValidationCache::Entry *ValidationCache::slotFor(const Key &key) const
+{
+	SHA1 hash;
+	hash(&key, sizeof(key));
+	SHA1::Digest digest;
+	hash.finish(digest);
+	uint32_t index;
+	memcpy(&index, digest, sizeof(index));
+	return mEntries + (index & (cacheEntries - 1));
+}
+
+bool ValidationCache::find(const Key &key)
+{
+	if (mEntries) {
+		StLock<Mutex> _(mLock);
+		Entry *entry = slotFor(key);
+		if (entry->valid && memcmp(&entry->key, &key, sizeof(key)) == 0) {
+			mHits++;
+			secinfo("validationcache", "hit (%llu hits, %llu misses)", (unsigned long long)mHits, (unsigned long long)mMisses);
+			return true;
+		}
+	}
+	mMisses++;
+	secinfo("validationcache", "miss (%llu hits, %llu misses)", (unsigned long long)mHits, (unsigned long long)mMisses);
+	return false;
+}
+
+void ValidationCache::insert(const Key &key)
+{
+	if (!mEntries)
+		return;
+	StLock<Mutex> _(mLock);
+	Entry *entry = slotFor(key);
+	entry->key = key;
+	entry->valid = true;
+}
+
+
+} // end namespace CodeSigning
+} // end namespace Security
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+//
+// validationcache - in-process record of successfully validated main executables
+//
+#ifndef _H_VALIDATIONCACHE
+#define _H_VALIDATIONCACHE
+
+#include <security_utilities/unix++.h>
+#include <security_utilities/threading.h>
+#include <security_utilities/globalizer.h>
+#include <CoreFoundation/CoreFoundation.h>
+#include <atomic>
+
+
+namespace Security {
+namespace CodeSigning {
+
+
+//
+// A ValidationCache remembers that the code pages of a main executable were
+// found to match their CodeDirectory, so that validating the same, unchanged
+// file again can skip hashing it.
+//
+// An entry is keyed by the cdhash together with the identity and state of the
+// file (device, inode, size, modification and status change times) and the
+// validation flags that affect the page check. Any change to any of these is a
+// miss. Only successful validations are recorded.
+//
+// The cache is a fixed-size, direct-mapped table in this process's memory.
+// It is deliberately never shared or persisted: anything outside the process
+// could forge entries, and a forged entry would skip the page check entirely.
+//
+class ValidationCache {
+	NOCOPY(ValidationCache)
+public:
+	ValidationCache();
+	~ValidationCache();
+
+	struct Key {
+		Key(CFDataRef cdhash, UnixPlusPlus::FileDesc fd, uint32_t flags);
+
+		uint8_t cdhash[20];
+		uint32_t flags;
+		uint64_t device;
+		uint64_t inode;
+		uint64_t size;
+		int64_t mtime[2];		// seconds, nanoseconds
+		int64_t ctime[2];		// seconds, nanoseconds
+	};
+
+	bool find(const Key &key);
+	void insert(const Key &key);
+
+	uint64_t hits() const { return mHits; }
+	uint64_t misses() const { return mMisses; }
+
+private:
+	struct Entry;
+
+	Entry *slotFor(const Key &key) const;
+
+	Mutex mLock;
+	Entry *mEntries;			// cache table (NULL if unavailable)
+	std::atomic<uint64_t> mHits;
+	std::atomic<uint64_t> mMisses;
+};
+
+extern ModuleNexus<ValidationCache> validationCache;
+
+
+} // end namespace CodeSigning
+} // end namespace Security
+
+#endif // !_H_VALIDATIONCACHE
@@ -73,6 +73,7 @@
 #include "ellipticMeasure.h"
 #include "falloc.h"
 #include "giantPortCommon.h"
+#include <pthread.h>
 
 #if 0
 #if	FEE_DEBUG
@@ -177,21 +178,119 @@ static void absg(giant g);  /* g := |g|. */
  * to malloc() for borrowGiant(). On a 90 Mhz Pentium, enabling the
  * giant stack package shows about a 1.35 speedup factor over an identical
  * CryptKit without the giant stacks enabled.
+ *
+ * The cache is per thread, so concurrent signers never contend on it.
+ * Scratch giants are rounded up to a power-of-two capacity between
+ * GIANT_POOL_MIN_DIGITS and GIANT_POOL_MAX_DIGITS and up to
+ * GIANT_POOL_DEPTH of each size are kept. Anything bigger goes straight
+ * to fmalloc() as before. Returned giants are cleared before they are
+ * cached since they routinely hold key material.
  */
+#define GIANT_POOL_ENABLE		1
+#define GIANT_POOL_MIN_SHIFT	3		/* 8 digits */
+#define GIANT_POOL_CLASSES		7		/* ... through 512 digits */
+#define GIANT_POOL_MIN_DIGITS	(1U << GIANT_POOL_MIN_SHIFT)
+#define GIANT_POOL_MAX_DIGITS	(1U << (GIANT_POOL_MIN_SHIFT + GIANT_POOL_CLASSES - 1))
+#define GIANT_POOL_DEPTH		8
+
+#if		GIANT_POOL_ENABLE
+
+typedef struct {
+	unsigned	count[GIANT_POOL_CLASSES];
+	giant		free[GIANT_POOL_CLASSES][GIANT_POOL_DEPTH];
+} giantPool;
+
+static pthread_key_t giantPoolKey;
+static pthread_once_t giantPoolOnce = PTHREAD_ONCE_INIT;
 
+static void giantPoolDestroy(void *arg)
+{
+	giantPool *pool = (giantPool *)arg;
+	unsigned cls, i;
+
+	for(cls=0; cls<GIANT_POOL_CLASSES; cls++) {
+		for(i=0; i<pool->count[cls]; i++) {
+			freeGiant(pool->free[cls][i]);
+		}
+	}
+	ffree(pool);
+}
 
+static void giantPoolKeyInit(void)
+{
+	pthread_key_create(&giantPoolKey, giantPoolDestroy);
+}
+
+static giantPool *giantPoolGet(void)
+{
+	giantPool *pool;
+
+	pthread_once(&giantPoolOnce, giantPoolKeyInit);
+	pool = (giantPool *)pthread_getspecific(giantPoolKey);
+	if(pool == NULL) {
+		pool = (giantPool *)fmalloc(sizeof(giantPool));
+		if(pool == NULL) {
+			return NULL;
+		}
+		memset(pool, 0, sizeof(giantPool));
+		if(pthread_setspecific(giantPoolKey, pool)) {
+			ffree(pool);
+			return NULL;
+		}
+	}
+	return pool;
+}
+
+/* size class for a request, or -1 if it's not pooled */
+static int giantPoolClass(unsigned numDigits)
+{
+	int cls = 0;
+
+	if(numDigits > GIANT_POOL_MAX_DIGITS) {
+		return -1;
+	}
+	while((GIANT_POOL_MIN_DIGITS << cls) < numDigits) {
+		cls++;
+	}
+	return cls;
+}
+
+#endif	/* GIANT_POOL_ENABLE */
 
 giant borrowGiant(unsigned numDigits)
 {
 	giant 		result;
-	result = newGiant(numDigits);
 
 	PROF_INCR(numBorrows);
+	#if		GIANT_POOL_ENABLE
+	int cls = giantPoolClass(numDigits);
+	if(cls >= 0) {
+		giantPool *pool = giantPoolGet();
+		if((pool != NULL) && pool->count[cls]) {
+			result = pool->free[cls][--pool->count[cls]];
+			result->sign = 0;
+			return result;
+		}
+		return newGiant(GIANT_POOL_MIN_DIGITS << cls);
+	}
+	#endif	/* GIANT_POOL_ENABLE */
+	result = newGiant(numDigits);
 	return result;
 }
 
 void returnGiant(giant g)
 {
+	#if		GIANT_POOL_ENABLE
+	int cls = giantPoolClass(g->capacity);
+	if((cls >= 0) && (g->capacity == (GIANT_POOL_MIN_DIGITS << cls))) {
+		giantPool *pool = giantPoolGet();
+		if((pool != NULL) && (pool->count[cls] < GIANT_POOL_DEPTH)) {
+			clearGiant(g);
+			pool->free[cls][pool->count[cls]++] = g;
+			return;
+		}
+	}
+	#endif	/* GIANT_POOL_ENABLE */
 	freeGiant(g);
 }
 
@@ -1089,15 +1188,83 @@ void gmersennemod(int n, giant g) {
 
 #endif	/* NEW_MERSENNE */
 
+/*
+ * Product scanning (Comba) kernels. Each output digit is the sum of a
+ * column of digit products, accumulated in a 64-bit word plus a digit's
+ * worth of overflow, so there is one store per output digit and no carry
+ * chain through the partial product rows.
+ */
+#if		GIANT_LOG2_BITS_PER_DIGIT > 5
+#error "Comba kernels need a double-digit accumulator type"
+#endif
+
+/* r[0..na+nb-1] := a[0..na-1] * b[0..nb-1]; r may not overlap a or b */
+static void giantMulComba(
+	const giantDigit *a, unsigned na,
+	const giantDigit *b, unsigned nb,
+	giantDigit *r)
+{
+	uint64_t	acc = 0;		/* column sum, low 64 bits */
+	giantDigit	accHi = 0;		/* column sum overflow */
+	unsigned	k, i, iEnd;
+
+	for(k=0; k<na+nb-1; k++) {
+		i = (k < nb) ? 0 : k - nb + 1;
+		iEnd = (k < na) ? k : na - 1;
+		for(; i<=iEnd; i++) {
+			uint64_t prod = (uint64_t)a[i] * b[k - i];
+			acc += prod;
+			accHi += (acc < prod);
+		}
+		r[k] = (giantDigit)acc;
+		acc = (acc >> GIANT_BITS_PER_DIGIT) |
+			((uint64_t)accHi << GIANT_BITS_PER_DIGIT);
+		accHi = 0;
+	}
+	r[na+nb-1] = (giantDigit)acc;
+}
+
+/* r[0..2n-1] := a[0..n-1]^2; cross products computed once and doubled */
+static void giantSqrComba(
+	const giantDigit *a, unsigned n,
+	giantDigit *r)
+{
+	uint64_t	acc = 0;
+	giantDigit	accHi = 0;
+	unsigned	k, i, j;
+
+	for(k=0; k<2*n-1; k++) {
+		uint64_t	cross = 0;
+		giantDigit	crossHi = 0;
+
+		i = (k < n) ? 0 : k - n + 1;
+		j = k - i;
+		for(; i<j; i++, j--) {
+			uint64_t prod = (uint64_t)a[i] * a[j];
+			cross += prod;
+			crossHi += (cross < prod);
+		}
+		crossHi = (crossHi << 1) | (giantDigit)(cross >> 63);
+		cross <<= 1;
+		if(i == j) {
+			uint64_t prod = (uint64_t)a[i] * a[i];
+			cross += prod;
+			crossHi += (cross < prod);
+		}
+		acc += cross;
+		accHi += crossHi + (acc < cross);
+		r[k] = (giantDigit)acc;
+		acc = (acc >> GIANT_BITS_PER_DIGIT) |
+			((uint64_t)accHi << GIANT_BITS_PER_DIGIT);
+		accHi = 0;
+	}
+	r[2*n-1] = (giantDigit)acc;
+}
+
 void mulg(giant a, giant b) { /* b becomes a*b. */
 
-    int i;
     int asize, bsize;
-    giantDigit *bptr = b->n;
-    giantDigit mult;
     giant scratch1;
-    giantDigit carry;
-    giantDigit *scrPtr;
 
 
     if (isZero(b)) {
@@ -1115,23 +1282,7 @@ void mulg(giant a, giant b) { /* b becomes a*b. */
     bsize = abs(b->sign);
     asize = abs(a->sign);
     scratch1 = borrowGiant((asize+bsize));
-    scrPtr = scratch1->n;
-
-    for(i=0; i<asize+bsize; ++i) {
-    	scrPtr[i]=0;
-    }
-
-    for(i=0; i<bsize; ++i, scrPtr++) {
-	mult = bptr[i];
-	if (mult != 0) {
-	    carry = VectorMultiply(mult,
-	    	a->n,
-		asize,
-		scrPtr);
-	    /* handle MSD carry */
-	    scrPtr[asize] += carry;
-	}
-    }
+    giantMulComba(a->n, asize, b->n, bsize, scratch1->n);
     bsize+=asize;
      if(scratch1->n[bsize - 1] == 0) {
         --bsize;
@@ -1151,23 +1302,8 @@ void mulg(giant a, giant b) { /* b becomes a*b. */
 }
 
 void grammarSquare(giant a) {
-    /*
-     * For now, we're going to match the old implementation line for
-     * line by maintaining prod, carry, and temp as double precision
-     * giantDigits. There is probably a much better implementation....
-     */
-    giantDigit		prodLo;
-    giantDigit		prodHi;
-    giantDigit		carryLo = 0;
-    giantDigit		carryHi = 0;
-    giantDigit		tempLo;
-    giantDigit		tempHi;
-    unsigned int	cur_term;
     unsigned		asize;
-    unsigned		max;
-    giantDigit		*ptr = a->n;
-    giantDigit		*ptr1;
-    giantDigit		*ptr2;
+    unsigned		rsize;
     giant 		scratch;
 
     /* dmitch 11 Jan 1998 - special case for a == 0 */
@@ -1176,89 +1312,13 @@ void grammarSquare(giant a) {
     }
     /* end a == 0 case */
     asize = abs(a->sign);
-    max = asize * 2 - 1;
     scratch = borrowGiant(2 * asize);
-    asize--;
-
-    /*
-     * temp = *ptr;
-     * temp *= temp;
-     * scratch->n[0] = temp;
-     * carry = temp >> 16;
-     */
-    giantMulDigits(*ptr, *ptr, &tempLo, &tempHi);
-    scratch->n[0] = tempLo;
-    carryLo = tempHi;
-    carryHi = 0;
-
-    for (cur_term = 1; cur_term < max; cur_term++) {
-	ptr1 = ptr2 = ptr;
-	if (cur_term <= asize) {
-	    ptr2 += cur_term;
-	} else {
-	    ptr1 += cur_term - asize;
-	    ptr2 += asize;
-	}
-
-	/*
-	 * prod = carry & 0xFFFF;
-	 * carry >>= 16;
-	 */
-	prodLo = carryLo;
-	prodHi = 0;
-	carryLo = carryHi;
-	carryHi = 0;
-	while(ptr1 < ptr2) {
-	    /*
-	     * temp = *ptr1++ * *ptr2--;
-	     */
-	    giantMulDigits(*ptr1++, *ptr2--, &tempLo, &tempHi);
-
-	    /*
-	     * prod += (temp << 1) & 0xFFFF;
-	     */
-	    giantAddDouble(&prodLo, &prodHi, (tempLo << 1));
-
-	    /*
-	     * carry += (temp >> 15);
-	     * use bits from both product digits..
-	     */
-	    giantAddDouble(&carryLo, &carryHi,
-	    	(tempLo >> (GIANT_BITS_PER_DIGIT - 1)));
-	    giantAddDouble(&carryLo, &carryHi, (tempHi << 1));
-
-	    /* snag the msb from that last shift */
-	    carryHi += (tempHi >> (GIANT_BITS_PER_DIGIT - 1));
-	}
-	if (ptr1 == ptr2) {
-	    /*
-	     * temp = *ptr1;
-	     * temp *= temp;
-	     */
-	    giantMulDigits(*ptr1, *ptr1, &tempLo, &tempHi);
-
-	    /*
-	     * prod += temp & 0xFFFF;
-	     */
-	    giantAddDouble(&prodLo, &prodHi, tempLo);
-
-	    /*
-	     * carry += (temp >> 16);
-	     */
-	    giantAddDouble(&carryLo, &carryHi, tempHi);
-	}
-
-	/*
-	 * carry += prod >> 16;
-	 */
-	giantAddDouble(&carryLo, &carryHi, prodHi);
-
-	scratch->n[cur_term] = prodLo;
+    giantSqrComba(a->n, asize, scratch->n);
+    rsize = 2 * asize;
+    if(scratch->n[rsize - 1] == 0) {
+	--rsize;
     }
-    if (carryLo) {
-	scratch->n[cur_term] = carryLo;
-	scratch->sign = cur_term+1;
-    } else scratch->sign = cur_term;
+    scratch->sign = rsize;
 
     gtog(scratch,a);
     returnGiant(scratch);
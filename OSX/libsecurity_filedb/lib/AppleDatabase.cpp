@@ -35,6 +35,7 @@
 #include <Security/cssmapplePriv.h>
 #include <syslog.h>
 #include <copyfile.h>
+#include <CommonCrypto/CommonDigest.h>
 
 static const char *kAppleDatabaseChanged = "com.apple.AppleDatabaseChanged";
 
@@ -44,6 +45,12 @@ static const char *kAppleDatabaseChanged = "com.apple.AppleDatabaseChanged";
    that any db on the system has changed. */
 static const CFTimeInterval kForceReReadTime = 15.0;
 
+/* An append log is folded back into a freshly written database once it would
+   grow past the larger of these two limits: a fixed minimum, or a fraction of
+   the size of the base image it follows. */
+static const uint32 kAppendLogMinimumSize = 64 * 1024;
+static const uint32 kAppendLogBaseDivisor = 4;
+
 /* Token on which we receive notifications and the pthread_once_t protecting
    it's initialization. */
 pthread_once_t gCommonInitMutex = PTHREAD_ONCE_INIT;
@@ -99,6 +106,20 @@ Table::~Table()
 	for_each_map_delete(mIndexMap.begin(), mIndexMap.end());
 }
 
+void
+Table::replaceTableSection(const ReadSection &inTableSection)
+{
+	for_each_map_delete(mIndexMap.begin(), mIndexMap.end());
+	mIndexMap.clear();
+
+	mTableSection = inTableSection;
+	mRecordsCount = inTableSection[OffsetRecordsCount];
+	mFreeListHead = inTableSection[OffsetFreeListHead];
+	mRecordNumbersCount = inTableSection[OffsetRecordNumbersCount];
+
+	readIndexSection();
+}
+
 void
 Table::readIndexSection()
 {
@@ -559,8 +580,9 @@ ModifiedTable::writeIndexSection(WriteSection &tableSection, uint32 offset)
 	return offset;
 }
 
+template <class OutputFile>
 uint32
-ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffset)
+ModifiedTable::writeTable(OutputFile &inOutputFile, uint32 inSectionOffset)
 {
 	if (mTable && !mIsModified) {
 		// the table has not been modified, so we can just dump the old table
@@ -569,7 +591,7 @@ ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffs
 		const ReadSection &tableSection = mTable->getTableSection();
 		uint32 tableSize = tableSection.at(Table::OffsetSize);
 
-		inAtomicTempFile.write(AtomicFile::FromStart, inSectionOffset,
+		inOutputFile.write(AtomicFile::FromStart, inSectionOffset,
 			tableSection.range(Range(0, tableSize)), tableSize);
 
 		return inSectionOffset + tableSize;
@@ -629,7 +651,7 @@ ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffs
 				// to but not including the current one to the new file.
 				if (aBlockSize > 0)
 				{
-					inAtomicTempFile.write(AtomicFile::FromStart, anOffset,
+					inOutputFile.write(AtomicFile::FromStart, anOffset,
 									   aRecordsSection.range(Range(aBlockStart,
 																   aBlockSize)),
 									   aBlockSize);
@@ -646,7 +668,7 @@ ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffs
 		// Copy all records that have not yet been copied to the new file.
 		if (aBlockSize > 0)
 		{
-			inAtomicTempFile.write(AtomicFile::FromStart, anOffset,
+			inOutputFile.write(AtomicFile::FromStart, anOffset,
 							   aRecordsSection.range(Range(aBlockStart,
 														   aBlockSize)),
 							   aBlockSize);
@@ -666,7 +688,7 @@ ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffs
 		// Put offset relative to start of this table in recordNumber array.
 		aTableSection.put(Table::OffsetRecordNumbers + AtomSize * aRecordNumber,
 						  anOffset - inSectionOffset);
-		inAtomicTempFile.write(AtomicFile::FromStart, anOffset,
+		inOutputFile.write(AtomicFile::FromStart, anOffset,
 						   aRecord.address(), aRecord.size());
 		anOffset += aRecord.size();
 		aRecordsCount++;
@@ -704,7 +726,7 @@ ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffs
 	{
 		uint32 indexOffset = anOffset;
 		anOffset = writeIndexSection(aTableSection, anOffset);
-		inAtomicTempFile.write(AtomicFile::FromStart, inSectionOffset + indexOffset,
+		inOutputFile.write(AtomicFile::FromStart, inSectionOffset + indexOffset,
 			aTableSection.address() + indexOffset, anOffset - indexOffset);
 	}
 
@@ -713,12 +735,112 @@ ModifiedTable::writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffs
 	aTableSection.put(Table::OffsetRecordsCount, aRecordsCount);
 
 	// Write out aTableSection header.
-	inAtomicTempFile.write(AtomicFile::FromStart, inSectionOffset,
+	inOutputFile.write(AtomicFile::FromStart, inSectionOffset,
 					   aTableSection.address(), aTableSection.size());
 
     return anOffset + inSectionOffset;
 }
 
+uint32
+ModifiedTable::writeLogEntry(WriteSection &inLogSection, uint32 inOffset) const
+{
+	inOffset = inLogSection.put(inOffset, getMetaRecord().dataRecordType());
+
+	inOffset = inLogSection.put(inOffset, (uint32)mDeletedSet.size());
+	DeletedSet::const_iterator aDeletedIt = mDeletedSet.begin();
+	for (; aDeletedIt != mDeletedSet.end(); aDeletedIt++)
+		inOffset = inLogSection.put(inOffset, *aDeletedIt);
+
+	// Inserted records are self describing (they start with their own size
+	// and record number), so they are logged exactly as writeTable() would
+	// write them.
+	inOffset = inLogSection.put(inOffset, (uint32)mInsertedMap.size());
+	InsertedMap::const_iterator anInsertedIt = mInsertedMap.begin();
+	for (; anInsertedIt != mInsertedMap.end(); anInsertedIt++)
+	{
+		const WriteSection &aRecord = *anInsertedIt->second;
+		inOffset = inLogSection.put(inOffset, aRecord.size(), aRecord.address());
+	}
+
+	return inOffset;
+}
+
+void
+ModifiedTable::replayDelete(uint32 inRecordNumber)
+{
+	modifyTable();
+
+	MutableIndexMap::iterator it;
+	for (it = mIndexMap.begin(); it != mIndexMap.end(); it++)
+		it->second->removeRecord(inRecordNumber);
+
+	InsertedMap::iterator anIt = mInsertedMap.find(inRecordNumber);
+	if (anIt != mInsertedMap.end())
+	{
+		// Inserted by an earlier log record.
+		delete anIt->second;
+		mInsertedMap.erase(anIt);
+	}
+	else if (!mTable || !mDeletedSet.insert(inRecordNumber).second)
+		CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
+}
+
+void
+ModifiedTable::replayInsert(const ReadSection &inRecordSection)
+{
+	modifyTable();
+
+	uint32 aRecordNumber = MetaRecord::unpackRecordNumber(inRecordSection);
+	if (mInsertedMap.find(aRecordNumber) != mInsertedMap.end())
+		CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
+
+	uint32 aRecordSize = inRecordSection.size();
+	unique_ptr<WriteSection> aWriteSection(new WriteSection(Allocator::standard(), aRecordSize));
+	aWriteSection->put(0, aRecordSize, inRecordSection.range(Range(0, aRecordSize)));
+	aWriteSection->size(aRecordSize);
+
+	MutableIndexMap::iterator it;
+	for (it = mIndexMap.begin(); it != mIndexMap.end(); it++)
+		it->second->insertRecord(aRecordNumber, *aWriteSection);
+
+	mInsertedMap.insert(InsertedMap::value_type(aRecordNumber, aWriteSection.get()));
+	aWriteSection.release();
+}
+
+//
+// TableSectionWriter -- lets ModifiedTable::writeTable() build a table section
+// in memory when replaying an append log.
+//
+class TableSectionWriter
+{
+public:
+	TableSectionWriter(WriteSection &inSection) : mSection(inSection) {}
+
+	void write(AtomicFile::OffsetType inOffsetType, off_t inOffset, const uint8 *inData, size_t inLength)
+	{
+		if (inOffsetType != AtomicFile::FromStart)
+			CssmError::throwMe(CSSM_ERRCODE_INTERNAL_ERROR);
+
+		uint32 anEnd = mSection.put((uint32)inOffset, (uint32)inLength, inData);
+		if (anEnd > mSection.size())
+			mSection.size(anEnd);
+	}
+
+private:
+	WriteSection &mSection;
+};
+
+//
+// Metadata
+//
+void
+Metadata::logRecordChecksum(const uint8 *inData, uint32 inLength, uint8 *outChecksum)
+{
+	uint8 aDigest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256(inData, inLength, aDigest);
+	memcpy(outChecksum, aDigest, LogRecordChecksumSize);
+}
+
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-const-variable"
@@ -868,6 +990,9 @@ static const CSSM_DB_ATTRIBUTE_INFO AttrSchemaParsingModule[] =
 //
 DbVersion::DbVersion(const AppleDatabase &db, const RefPointer <AtomicBufferedFile> &inAtomicBufferedFile) :
 	mDatabase(reinterpret_cast<const uint8 *>(NULL), 0),
+	mHasAppendLog(false),
+	mBaseEnd(0),
+	mLogEnd(0),
 	mDb(db),
 	mBufferedFile(inAtomicBufferedFile)
 {
@@ -884,6 +1009,7 @@ DbVersion::~DbVersion()
 	try
 	{
 		for_each_map_delete(mTableMap.begin(), mTableMap.end());
+		for_each_delete(mReplayedSections.begin(), mReplayedSections.end());
 	}
 	catch(...) {}
 }
@@ -901,10 +1027,12 @@ DbVersion::open()
 		if (aHeaderSection.at(OffsetMagic) != HeaderMagic)
 			CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
 
-		// We currently only support one version.  If we support additional
-		// file format versions in the future fix this.
+		// HeaderVersionAppendLog is HeaderVersion plus an optional append log
+		// after the base image.
 		uint32 aVersion = aHeaderSection.at(OffsetVersion);
-		if (aVersion != HeaderVersion)
+		if (aVersion == HeaderVersionAppendLog)
+			mHasAppendLog = true;
+		else if (aVersion != HeaderVersion)
 			CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
 
 		//const ReadSection anAuthSection =
@@ -924,6 +1052,11 @@ DbVersion::open()
 		if (aSchemaSize < OffsetTables + AtomSize * aTableCount)
 			CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
 
+		// The base image ends with the versionId atom following the schema.
+		mBaseEnd = CheckUInt32Add(CheckUInt32Add(HeaderOffset + aSchemaOffset, aSchemaSize), AtomSize);
+		if (mBaseEnd > mDatabase.size())
+			CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
+
 		for (uint32 aTableNumber = 0; aTableNumber < aTableCount;
 			 aTableNumber++)
 		{
@@ -1097,6 +1230,13 @@ DbVersion::open()
 			for (it = mTableMap.begin(); it != mTableMap.end(); it++)
 				it->second->readIndexSection();
 		}
+
+		mLogEnd = mBaseEnd;
+		if (mHasAppendLog)
+		{
+			mVersionId = mDatabase.at(mBaseEnd - AtomSize);
+			replayLog(mBaseEnd);
+		}
 	}
 	catch(...)
 	{
@@ -1106,6 +1246,114 @@ DbVersion::open()
 	}
 }
 
+//
+// Apply the records of the append log starting at inOffset to the tables read
+// from the base image.  Replay stops at the first record that is incomplete or
+// fails its checksum: that is a commit that never finished, and the next one
+// will be written over it.
+//
+void
+DbVersion::replayLog(uint32 inOffset)
+{
+	typedef map<Table::Id, ModifiedTable *> ModifiedTableMap;
+	ModifiedTableMap aModifiedTableMap;
+
+	try
+	{
+		uint8 aChecksum[LogRecordChecksumSize];
+		while (mDatabase.size() - inOffset >= LogRecordHeaderSize + LogRecordTrailerSize)
+		{
+			const ReadSection aLogSection = mDatabase.subsection(inOffset);
+			if (aLogSection.at(OffsetLogRecordMagic) != LogRecordMagic)
+				break;
+
+			uint32 aRecordSize = aLogSection.at(OffsetLogRecordSize);
+			if (aRecordSize < LogRecordHeaderSize + LogRecordTrailerSize
+				|| aRecordSize > aLogSection.size()
+				|| ReadSection::align(aRecordSize) != aRecordSize)
+				break;
+
+			uint32 aChecksumOffset = aRecordSize - LogRecordTrailerSize;
+			logRecordChecksum(aLogSection.range(Range(0, aChecksumOffset)), aChecksumOffset, aChecksum);
+			if (memcmp(aChecksum, aLogSection.range(Range(aChecksumOffset, LogRecordChecksumSize)), LogRecordChecksumSize))
+				break;
+
+			// From here on the record is known to be complete, so anything
+			// inconsistent in it means the database is corrupt.
+			const ReadSection aRecord = aLogSection.subsection(0, aChecksumOffset);
+			uint32 aTablesCount = aRecord.at(OffsetLogTablesCount);
+			uint32 anOffset = LogRecordHeaderSize;
+			for (uint32 aTable = 0; aTable < aTablesCount; aTable++)
+			{
+				Table::Id aTableId = aRecord.at(anOffset);
+				anOffset += AtomSize;
+
+				ModifiedTableMap::iterator it = aModifiedTableMap.find(aTableId);
+				if (it == aModifiedTableMap.end())
+				{
+					unique_ptr<ModifiedTable> aModifiedTable(new ModifiedTable(&findTable(aTableId)));
+					it = aModifiedTableMap.insert(ModifiedTableMap::value_type(aTableId, aModifiedTable.get())).first;
+					aModifiedTable.release();
+				}
+
+				uint32 aDeletedCount = aRecord.at(anOffset);
+				anOffset += AtomSize;
+				for (uint32 aDeleted = 0; aDeleted < aDeletedCount; aDeleted++)
+				{
+					it->second->replayDelete(aRecord.at(anOffset));
+					anOffset += AtomSize;
+				}
+
+				uint32 anInsertedCount = aRecord.at(anOffset);
+				anOffset += AtomSize;
+				for (uint32 anInserted = 0; anInserted < anInsertedCount; anInserted++)
+				{
+					ReadSection aRecordSection = MetaRecord::readSection(aRecord, anOffset);
+					it->second->replayInsert(aRecordSection);
+					anOffset = ReadSection::align(CheckUInt32Add(anOffset, aRecordSection.size()));
+				}
+			}
+
+			if (anOffset != aChecksumOffset)
+				CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
+
+			mVersionId = aLogSection.at(OffsetLogVersionId);
+			inOffset += aRecordSize;
+		}
+
+		mLogEnd = inOffset;
+
+		// Rebuild the section of every table the log touched.  Each
+		// ModifiedTable refers to the indexes of its Table, so all sections
+		// are built before any Table is switched over to its new one.
+		vector<ReadSection> aTableSections;
+		ModifiedTableMap::iterator it;
+		for (it = aModifiedTableMap.begin(); it != aModifiedTableMap.end(); it++)
+		{
+			unique_ptr<WriteSection> aSection(new WriteSection());
+			TableSectionWriter aWriter(*aSection);
+			uint32 aTableSize = it->second->writeTable(aWriter, 0);
+			mReplayedSections.push_back(aSection.get());
+			aSection.release();
+			aTableSections.push_back(ReadSection(mReplayedSections.back()->address(), aTableSize));
+		}
+
+		vector<ReadSection>::const_iterator aSectionIt = aTableSections.begin();
+		for (it = aModifiedTableMap.begin(); it != aModifiedTableMap.end(); it++, aSectionIt++)
+		{
+			Table::Id aTableId = it->first;
+			delete it->second;
+			it->second = NULL;
+			findTable(aTableId).replaceTableSection(*aSectionIt);
+		}
+	}
+	catch(...)
+	{
+		for_each_map_delete(aModifiedTableMap.begin(), aModifiedTableMap.end());
+		throw;
+	}
+}
+
 const RecordId
 DbVersion::getRecord(Table::Id inTableId, const RecordId &inRecordId,
 							CSSM_DB_RECORD_ATTRIBUTE_DATA *inoutAttributes,
@@ -1375,7 +1623,8 @@ DbModifier::DbModifier(AtomicFile &inAtomicFile, const AppleDatabase &db) :
 	Metadata(),
 	mDbVersion(),
     mAtomicFile(inAtomicFile),
-	mDb(db)
+	mDb(db),
+	mAppendLog(false)
 {
 }
 
@@ -1431,9 +1680,14 @@ DbModifier::getDbVersion(bool force)
             ReadSection aVersionSection(ptr, (size_t)bytesRead);
             uint32 aVersionId = aVersionSection[0];
 
-            /* If the version stamp hasn't changed the old mDbVersion is still
-               current. */
-            if (aVersionId == mDbVersion->getVersionId())
+            /* If neither the version stamp nor the file length has changed the
+               old mDbVersion is still current.  An append log commit always
+               changes the length, unless it was written over a torn record
+               that is never cut off; so if the old mDbVersion had a torn tail
+               the file has to be read again. */
+            if (aVersionId == mDbVersion->getVersionId()
+                && length == (off_t)mDbVersion->fileLength()
+                && (!mDbVersion->hasAppendLog() || length == (off_t)mDbVersion->logEnd()))
                 return mDbVersion;
         }
 
@@ -1446,7 +1700,7 @@ DbModifier::getDbVersion(bool force)
 void
 DbModifier::createDatabase(const CSSM_DBINFO &inDbInfo,
 						   const CSSM_ACL_ENTRY_INPUT *inInitialAclEntry,
-						   mode_t mode)
+						   mode_t mode, bool appendLog)
 {
 	// XXX This needs better locking.  There is a possible race condition between
 	// two concurrent creators.  Or a writer/creator or a close/create etc.
@@ -1456,6 +1710,7 @@ DbModifier::createDatabase(const CSSM_DBINFO &inDbInfo,
     mAtomicTempFile = mAtomicFile.create(mode);
 	// Set mVersionId to one since this is the first version of the database.
 	mVersionId = 1;
+	mAppendLog = appendLog;
 
 	// we need to create the meta tables first, because inserting tables
 	// (including the meta tables themselves) relies on them being there
@@ -1543,6 +1798,9 @@ DbModifier::modifyDatabase()
 		if (mVersionId == 0)
 			mVersionId = 1;
 
+		// Keep writing the database in the format it is in.
+		mAppendLog = mDbVersion->hasAppendLog();
+
 		// Remove all old modified tables
 		for_each_map_delete(mModifiedTableMap.begin(), mModifiedTableMap.end());
 		mModifiedTableMap.clear();
@@ -1689,35 +1947,38 @@ DbModifier::commit()
     {
         secinfo("integrity", "committing to %s", mAtomicFile.path().c_str());
 
-		WriteSection aHeaderSection(Allocator::standard(), size_t(HeaderSize));
-		// Set aHeaderSection to the correct size.
-		aHeaderSection.size(HeaderSize);
-
-        // Start writing sections after the header
-        uint32 anOffset = HeaderOffset + HeaderSize;
-
-        // Write auth section
-		aHeaderSection.put(OffsetAuthOffset, anOffset);
-        anOffset = writeAuthSection(anOffset);
-        // Write schema section
-		aHeaderSection.put(OffsetSchemaOffset, anOffset);
-        anOffset = writeSchemaSection(anOffset);
-
-		// Write out the file header.
-		aHeaderSection.put(OffsetMagic, HeaderMagic);
-		aHeaderSection.put(OffsetVersion, HeaderVersion);
-        mAtomicTempFile->write(AtomicFile::FromStart, HeaderOffset,
-							   aHeaderSection.address(), aHeaderSection.size());
-
-		// Write out the versionId.
-		WriteSection aVersionSection(Allocator::standard(), size_t(AtomSize));
-		anOffset = aVersionSection.put(0, mVersionId);
-		aVersionSection.size(anOffset);
-
-        mAtomicTempFile->write(AtomicFile::FromEnd, 0,
-							   aVersionSection.address(), aVersionSection.size());
-
-		mAtomicTempFile->commit();
+		if (!commitToLog())
+		{
+			WriteSection aHeaderSection(Allocator::standard(), size_t(HeaderSize));
+			// Set aHeaderSection to the correct size.
+			aHeaderSection.size(HeaderSize);
+
+			// Start writing sections after the header
+			uint32 anOffset = HeaderOffset + HeaderSize;
+
+			// Write auth section
+			aHeaderSection.put(OffsetAuthOffset, anOffset);
+			anOffset = writeAuthSection(anOffset);
+			// Write schema section
+			aHeaderSection.put(OffsetSchemaOffset, anOffset);
+			anOffset = writeSchemaSection(anOffset);
+
+			// Write out the file header.
+			aHeaderSection.put(OffsetMagic, HeaderMagic);
+			aHeaderSection.put(OffsetVersion, mAppendLog ? HeaderVersionAppendLog : HeaderVersion);
+			mAtomicTempFile->write(AtomicFile::FromStart, HeaderOffset,
+								   aHeaderSection.address(), aHeaderSection.size());
+
+			// Write out the versionId.
+			WriteSection aVersionSection(Allocator::standard(), size_t(AtomSize));
+			anOffset = aVersionSection.put(0, mVersionId);
+			aVersionSection.size(anOffset);
+
+			mAtomicTempFile->write(AtomicFile::FromEnd, 0,
+								   aVersionSection.address(), aVersionSection.size());
+
+			mAtomicTempFile->commit();
+		}
 		mAtomicTempFile = NULL;
 	   /* Initialize the shared memory file change mechanism */
 	   pthread_once(&gCommonInitMutex, initCommon);
@@ -1743,6 +2004,78 @@ DbModifier::commit()
     }
 }
 
+//
+// Commit by appending a log record to the current database file instead of
+// writing out a new one.  This is only done for record changes to existing
+// tables (never schema changes), on local volumes, and while the log stays
+// small relative to the base image; otherwise commit() rewrites the whole
+// database, which also folds any existing log back into the base image.
+//
+bool
+DbModifier::commitToLog()
+{
+	if (!mAppendLog || !mAtomicFile.isOnLocalFileSystem())
+		return false;
+
+	RefPointer<const DbVersion> aDbVersion;
+	{
+		StLock<Mutex> _(mDbVersionLock);
+		aDbVersion = mDbVersion;
+	}
+
+	// A newly created database has no base image to append to yet.
+	if (!aDbVersion)
+		return false;
+
+	if (mModifiedTableMap.size() != aDbVersion->mTableMap.size())
+		return false;
+
+	uint32 aTablesCount = 0;
+	ModifiedTableMap::const_iterator anIt;
+	for (anIt = mModifiedTableMap.begin(); anIt != mModifiedTableMap.end(); anIt++)
+	{
+		if (anIt->second->hasNewMetaRecord()
+			|| aDbVersion->mTableMap.find(anIt->first) == aDbVersion->mTableMap.end())
+			return false;
+
+		if (anIt->second->isModified())
+		{
+			if (CSSM_DB_RECORDTYPE_SCHEMA_START <= anIt->first && anIt->first < CSSM_DB_RECORDTYPE_SCHEMA_END)
+				return false;
+			aTablesCount++;
+		}
+	}
+
+	WriteSection aLogRecord;
+	uint32 anOffset = LogRecordHeaderSize;
+	for (anIt = mModifiedTableMap.begin(); anIt != mModifiedTableMap.end(); anIt++)
+		if (anIt->second->isModified())
+			anOffset = anIt->second->writeLogEntry(aLogRecord, anOffset);
+
+	uint32 aRecordSize = CheckUInt32Add(anOffset, LogRecordTrailerSize);
+	uint32 aLogSize = aDbVersion->mLogEnd - aDbVersion->mBaseEnd;
+	uint32 aLogLimit = max(kAppendLogMinimumSize, aDbVersion->mBaseEnd / kAppendLogBaseDivisor);
+	if (aRecordSize > aLogLimit || aLogSize > aLogLimit - aRecordSize)
+	{
+		secinfo("integrity", "compacting append log of %s (%u bytes)", mAtomicFile.path().c_str(), aLogSize);
+		return false;
+	}
+
+	aLogRecord.put(OffsetLogRecordMagic, LogRecordMagic);
+	aLogRecord.put(OffsetLogRecordSize, aRecordSize);
+	aLogRecord.put(OffsetLogVersionId, mVersionId);
+	aLogRecord.put(OffsetLogTablesCount, aTablesCount);
+
+	uint8 aChecksum[LogRecordChecksumSize];
+	logRecordChecksum(aLogRecord.address(), anOffset, aChecksum);
+	anOffset = aLogRecord.put(anOffset, LogRecordChecksumSize, aChecksum);
+	anOffset = aLogRecord.put(anOffset, mVersionId);
+	aLogRecord.size(anOffset);
+
+	mAtomicTempFile->commitAppend(aDbVersion->mLogEnd, aLogRecord.address(), aLogRecord.size());
+	return true;
+}
+
 void
 DbModifier::rollback() _NOEXCEPT
 {
@@ -2035,7 +2368,8 @@ AppleDbContext::AppleDbContext(Database &inDatabase,
 							   const void *inOpenParameters) :
 	DbContext(inDatabase, inDatabaseSession, inAccessRequest, inAccessCred),
 	mAutoCommit(true),
-	mMode(0666)
+	mMode(0666),
+	mAppendLog(false)
 {
 	const CSSM_APPLEDL_OPEN_PARAMETERS *anOpenParameters =
 		reinterpret_cast<const CSSM_APPLEDL_OPEN_PARAMETERS *>(inOpenParameters);
@@ -2050,6 +2384,8 @@ AppleDbContext::AppleDbContext(Database &inDatabase,
 
 			if (anOpenParameters->mask & kCSSM_APPLEDL_MASK_MODE)
 				mMode = anOpenParameters->mode;
+			if (anOpenParameters->mask & kCSSM_APPLEDL_MASK_APPEND_LOG)
+				mAppendLog = true;
 			/*DROPTHROUGH*/
 		case 0:
 			if (anOpenParameters->length < sizeof(CSSM_APPLEDL_OPEN_PARAMETERS_V0))
@@ -2132,7 +2468,7 @@ AppleDatabase::dbCreate(DbContext &inDbContext, const CSSM_DBINFO &inDBInfo,
     try
     {
 		StLock<Mutex> _(mWriteLock);
-        mDbModifier.createDatabase(inDBInfo, inInitialAclEntry, context.mode());
+        mDbModifier.createDatabase(inDBInfo, inInitialAclEntry, context.mode(), context.appendLog());
     }
     catch(...)
     {
@@ -103,6 +103,10 @@ public:
 	bool matchesTableId(Id inTableId) const;
 
 	void readIndexSection();
+
+	// Switch this table over to a rebuilt copy of its section (used when
+	// replaying the append log) and reread its indexes.
+	void replaceTableSection(const ReadSection &inTableSection);
 	
 	enum
 	{
@@ -119,7 +123,7 @@ protected:
 	friend class ModifiedTable;
 	
 	MetaRecord mMetaRecord;
-	const ReadSection mTableSection;
+	ReadSection mTableSection;
 
 	uint32 mRecordsCount;
 	uint32 mFreeListHead;
@@ -160,7 +164,17 @@ public:
 	DbMutableIndex &findIndex(uint32 indexId, const MetaRecord &metaRecord, bool isUniqueIndex);
 
 	// Write this table to inOutputFile at inSectionOffset and return the new offset.
-    uint32 writeTable(AtomicTempFile &inAtomicTempFile, uint32 inSectionOffset);
+	template <class OutputFile>
+    uint32 writeTable(OutputFile &inOutputFile, uint32 inSectionOffset);
+
+	// Append-log support.  writeLogEntry() records this table's pending changes
+	// (if any) at inOffset in inLogSection and returns the new offset; the replay
+	// methods apply such changes, read back from the log, to this table.
+	bool isModified() const { return mIsModified; }
+	bool hasNewMetaRecord() const { return mNewMetaRecord != nil; }
+	uint32 writeLogEntry(WriteSection &inLogSection, uint32 inOffset) const;
+	void replayDelete(uint32 inRecordNumber);
+	void replayInsert(const ReadSection &inRecordSection);
 
 private:
 	// Return the next available record number for this table.
@@ -219,9 +233,29 @@ protected:
         HeaderSize			= AtomSize * 4,
 
         HeaderMagic			= FOUR_CHAR_CODE('kych'),
-        HeaderVersion		= 0x00010000
+        HeaderVersion		= 0x00010000,
+
+		// A database in this format may have an append log following the
+		// versionId atom that ends the base image.  Each log record is:
+		//   magic, size (of the whole record), versionId, table count,
+		//   per table: table id, deleted record number count, deleted record
+		//     numbers, inserted record count, inserted records,
+		//   checksum (2 atoms, over everything before it), versionId.
+		// The final versionId keeps the versionId the last atom in the file.
+		HeaderVersionAppendLog	= 0x00010001,
+		LogRecordMagic			= FOUR_CHAR_CODE('alog'),
+		OffsetLogRecordMagic	= AtomSize * 0,
+		OffsetLogRecordSize		= AtomSize * 1,
+		OffsetLogVersionId		= AtomSize * 2,
+		OffsetLogTablesCount	= AtomSize * 3,
+		LogRecordHeaderSize		= AtomSize * 4,
+		LogRecordChecksumSize	= AtomSize * 2,
+		LogRecordTrailerSize	= LogRecordChecksumSize + AtomSize
     };
 
+	// Compute the LogRecordChecksumSize byte checksum of an append log record.
+	static void logRecordChecksum(const uint8 *inData, uint32 inLength, uint8 *outChecksum);
+
 	enum
 	{
 		OffsetSchemaSize	= AtomSize * 0,
@@ -241,6 +275,9 @@ public:
     ~DbVersion();
 
 	uint32 getVersionId() const { return mVersionId; }
+	bool hasAppendLog() const { return mHasAppendLog; }
+	size_t fileLength() const { return mDatabase.size(); }
+	uint32 logEnd() const { return mLogEnd; }
 	const RecordId getRecord(Table::Id inTableId, const RecordId &inRecordId,
 							 CSSM_DB_RECORD_ATTRIBUTE_DATA *inoutAttributes,
 							 CssmData *inoutData, Allocator &inAllocator) const;
@@ -251,10 +288,20 @@ protected:
 
 private:
     void open(); // Part of constructor contract.
+	void replayLog(uint32 inOffset);
 
 	ReadSection mDatabase;
     uint32 mVersionId;
 
+	// Append log state: whether the file format allows one, where the base
+	// image ends, where the next log record goes, and the rebuilt sections of
+	// the tables that log records touched.
+	bool mHasAppendLog;
+	uint32 mBaseEnd;
+	uint32 mLogEnd;
+	typedef vector<WriteSection *> ReplayedSectionVector;
+	ReplayedSectionVector mReplayedSections;
+
 	friend class DbModifier; // XXX Fixme
     typedef map<Table::Id, Table *> TableMap;
     TableMap mTableMap;
@@ -407,7 +454,7 @@ public:
 	// Whole database affecting members.
     void createDatabase(const CSSM_DBINFO &inDbInfo,
 						const CSSM_ACL_ENTRY_INPUT *inInitialAclEntry,
-						mode_t mode);
+						mode_t mode, bool appendLog = false);
 	void openDatabase(); // This is optional right now.
 	void closeDatabase();
 	void deleteDatabase();
@@ -458,6 +505,10 @@ protected:
 
     uint32 writeAuthSection(uint32 inSectionOffset);
     uint32 writeSchemaSection(uint32 inSectionOffset);
+
+	// Try to commit the pending changes as an append log record; returns false
+	// if they have to be written out as a whole new database instead.
+	bool commitToLog();
 	
 private:
 	
@@ -475,6 +526,9 @@ private:
     uint32 mVersionId;
 	RefPointer<AtomicTempFile> mAtomicTempFile;
 
+	// Write HeaderVersionAppendLog databases and append small commits to them.
+	bool mAppendLog;
+
     typedef map<Table::Id, ModifiedTable *> ModifiedTableMap;
     ModifiedTableMap mModifiedTableMap;
 	
@@ -509,10 +563,12 @@ public:
 	bool autoCommit() const { return mAutoCommit; }
 	void autoCommit(bool on) { mAutoCommit = on; }
 	mode_t mode() const { return mMode; }
+	bool appendLog() const { return mAppendLog; }
 
 private:
 	bool mAutoCommit;
 	mode_t mMode;
+	bool mAppendLog;
 };
 
 //
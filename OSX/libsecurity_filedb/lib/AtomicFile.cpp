@@ -376,14 +376,17 @@ AtomicFile::rclose(int fd)
 
 //
 // AtomicBufferedFile - This represents an instance of a file opened for reading.
-// The file is read into memory and closed after this is done.
+// On a local filesystem the file is mapped read-only into memory, otherwise it
+// is read into memory.  Either way it is closed after this is done.
 // The memory is released when this object is destroyed.
 //
 AtomicBufferedFile::AtomicBufferedFile(const std::string &inPath, bool isLocal) :
 	mPath(inPath),
 	mFileRef(-1),
 	mBuffer(NULL),
-	mLength(0)
+	mLength(0),
+	mIsLocalFileSystem(isLocal),
+	mMapped(false)
 {
 }
 
@@ -417,6 +420,12 @@ AtomicBufferedFile::open()
 		close();
 	}
 
+	// A mapping is sized to the file it was made from, so drop it before mLength changes.
+	if (mMapped)
+	{
+		unloadBuffer();
+	}
+
 	mFileRef = AtomicFile::ropen(path, O_RDONLY, 0);
     if (mFileRef == -1)
     {
@@ -460,16 +469,40 @@ void
 AtomicBufferedFile::unloadBuffer()
 {
     if(mBuffer) {
-        delete [] mBuffer;
+        if (mMapped) {
+            if (::munmap(mBuffer, (size_t) mLength) == -1) {
+                secnotice("atomicfile", "munmap(%s): %s", mPath.c_str(), strerror(errno));
+            }
+            mMapped = false;
+        } else {
+            delete [] mBuffer;
+        }
         mBuffer = NULL;
     }
 }
 
 //
 // Load the contents of the file into memory.
+//
+// Files on a local volume are mapped rather than copied.  Writers never modify
+// bytes a reader may rely on; AtomicTempFile either writes a new file and renames
+// it over the old one, or (commitAppend) writes past the end of the data the
+// previous commit left behind, so the pages we use stay valid and unchanged for
+// the lifetime of this object.  Network filesystems make no such guarantee, so
+// for those we keep reading into a private buffer.
 void
 AtomicBufferedFile::loadBuffer()
 {
+    if (mIsLocalFileSystem && mLength > 0) {
+        void *mapping = ::mmap(NULL, (size_t) mLength, PROT_READ, MAP_FILE | MAP_PRIVATE, mFileRef, 0);
+        if (mapping != MAP_FAILED) {
+            mBuffer = reinterpret_cast<uint8 *>(mapping);
+            mMapped = true;
+            return;
+        }
+        secnotice("atomicfile", "mmap(%s, %qd): %s, falling back to read", mPath.c_str(), mLength, strerror(errno));
+    }
+
     // make a buffer big enough to hold the entire file
     mBuffer = new uint8[(size_t) mLength];
     if(lseek(mFileRef, 0, SEEK_SET) < 0) {
@@ -513,22 +546,30 @@ AtomicBufferedFile::loadBuffer()
 const uint8 *
 AtomicBufferedFile::read(off_t inOffset, off_t inLength, off_t &outLength)
 {
-	if (mFileRef < 0)
+	if (mFileRef < 0 && !mMapped)
 	{
 		secinfo("atomicfile", "read %s: file yet not opened, opening", mPath.c_str());
 		open();
 	}
 
 	off_t bytesLeft = inLength;
-	if (mBuffer)
+	if (mBuffer && mMapped)
 	{
-		secinfo("atomicfile", "%p free %s buffer %p", this, mPath.c_str(), mBuffer);
-		unloadBuffer();
+		// The mapping already covers the whole file; there is nothing to reload.
+		secinfo("atomicfile", "%p reusing %s mapping %p", this, mPath.c_str(), mBuffer);
 	}
+	else
+	{
+		if (mBuffer)
+		{
+			secinfo("atomicfile", "%p free %s buffer %p", this, mPath.c_str(), mBuffer);
+			unloadBuffer();
+		}
 
-	loadBuffer();
-	
-	secinfo("atomicfile", "%p allocated %s buffer %p size %qd", this, mPath.c_str(), mBuffer, bytesLeft);
+		loadBuffer();
+
+		secinfo("atomicfile", "%p %s %s buffer %p size %qd", this, mMapped ? "mapped" : "allocated", mPath.c_str(), mBuffer, bytesLeft);
+	}
 	
 	off_t maxEnd = inOffset + inLength;
 	if (maxEnd > mLength)
@@ -696,34 +737,40 @@ AtomicTempFile::write(AtomicFile::OffsetType inOffsetType, off_t inOffset, const
 	else
 		CssmError::throwMe(CSSM_ERRCODE_INTERNAL_ERROR);
 
+	writeFully(mFileRef, mPath, pos, inData, inLength);
+}
+
+void
+AtomicTempFile::writeFully(int fileRef, const string &path, off_t pos, const uint8 *inData, size_t inLength)
+{
 	off_t bytesLeft = inLength;
 	const uint8 *ptr = inData;
 	while (bytesLeft)
 	{
 		size_t toWrite = bytesLeft > kAtomicFileMaxBlockSize ? kAtomicFileMaxBlockSize : size_t(bytesLeft);
-		ssize_t bytesWritten = ::pwrite(mFileRef, ptr, toWrite, pos);
+		ssize_t bytesWritten = ::pwrite(fileRef, ptr, toWrite, pos);
 		if (bytesWritten == -1)
 		{
 			int error = errno;
 			if (error == EINTR)
 			{
 				// We got interrupted by a signal, so try again.
-				secnotice("atomicfile", "write %s: interrupted, retrying", mPath.c_str());
+				secnotice("atomicfile", "write %s: interrupted, retrying", path.c_str());
 				continue;
 			}
 
-			secnotice("atomicfile", "write %s: %s", mPath.c_str(), strerror(error));
+			secnotice("atomicfile", "write %s: %s", path.c_str(), strerror(error));
 			UnixError::throwMe(error);
 		}
 
 		// Write returning 0 is bad mmkay.
 		if (bytesWritten == 0)
 		{
-			secnotice("atomicfile", "write %s: 0 bytes written", mPath.c_str());
+			secnotice("atomicfile", "write %s: 0 bytes written", path.c_str());
 			CssmError::throwMe(CSSMERR_DL_INTERNAL_ERROR);
 		}
 
-		secdebug("atomicfile", "%p wrote %s %ld bytes from %p", this, mPath.c_str(), bytesWritten, ptr);
+		secdebug("atomicfile", "%p wrote %s %ld bytes from %p", this, path.c_str(), bytesWritten, ptr);
 
 		bytesLeft -= bytesWritten;
 		ptr += bytesWritten;
@@ -828,6 +875,77 @@ AtomicTempFile::commit()
 	}
 }
 
+// Write inData into the original file at inOffset and discard the temp file.  We are
+// still holding the write lock, so no other writer can be appending concurrently.
+// Readers never rely on bytes past what the previous commit left behind, so the only
+// thing a crash here can leave is a partial record that readers skip because it
+// doesn't validate.  The file is never shrunk: readers map it for its whole length,
+// and touching a mapped page past a new end of file would fault.  If a torn record
+// from an earlier failure lies beyond inData, its first atom is zeroed instead, so it
+// can never be read as the start of another record.  Note that a throw during the
+// commit does an automatic rollback.
+void
+AtomicTempFile::commitAppend(off_t inOffset, const uint8 *inData, size_t inLength)
+{
+	const char *path = mFile.path().c_str();
+	int fileRef = AtomicFile::ropen(path, O_WRONLY, 0);
+	if (fileRef == -1)
+	{
+		int error = errno;
+		secnotice("atomicfile", "open %s: %s", path, strerror(error));
+		rollback();
+		UnixError::throwMe(error);
+	}
+
+	try
+	{
+		writeFully(fileRef, mFile.path(), inOffset, inData, inLength);
+
+		struct stat st;
+		if (::fstat(fileRef, &st) == -1)
+		{
+			int error = errno;
+			secnotice("atomicfile", "fstat %s: %s", path, strerror(error));
+			UnixError::throwMe(error);
+		}
+		off_t end = inOffset + inLength;
+		if (st.st_size >= end + off_t(sizeof(uint32)))
+		{
+			uint32 zero = 0;
+			writeFully(fileRef, mFile.path(), end, reinterpret_cast<const uint8 *>(&zero), sizeof(zero));
+		}
+
+		int result;
+		do
+		{
+			result = ::fsync(fileRef);
+		} while (result && errno == EINTR);
+
+		if (result == -1)
+		{
+			int error = errno;
+			secnotice("atomicfile", "fsync %s: %s", path, strerror(error));
+			UnixError::throwMe(error);
+		}
+
+		AtomicFile::rclose(fileRef);
+		secnotice("atomicfile", "%p appended %zu bytes to %s at %qd", this, inLength, path, inOffset);
+
+		// We never needed the temp file, so get rid of it and unlock the lockfile
+		rollback();
+		mLockedFile = NULL;
+	}
+	catch (...)
+	{
+		// Make sure whatever made it to disk doesn't validate as a complete record.
+		uint32 zero = 0;
+		::pwrite(fileRef, &zero, sizeof(zero), inOffset);
+		AtomicFile::rclose(fileRef);
+		rollback();
+		throw;
+	}
+}
+
 // Rollback the current create or write (happens automatically if commit() isn't called before the destructor is.
 void
 AtomicTempFile::rollback() _NOEXCEPT
@@ -85,7 +85,8 @@ private:
 
 //
 // AtomicBufferedFile - This represents an instance of a file opened for reading.
-// The file is read into memory and closed after this is done.
+// On a local filesystem the file is mapped read-only into memory, otherwise it
+// is read into memory.  Either way it is closed after this is done.
 // The memory is released when this object is destroyed.
 //
 class AtomicBufferedFile : public RefCount
@@ -125,6 +126,12 @@ private:
 
 	// Length of file in bytes.
 	off_t mLength;
+
+	// True if the file lives on a local volume and may be mapped.
+	bool mIsLocalFileSystem;
+
+	// True if mBuffer is a mapping of the file rather than a heap copy.
+	bool mMapped;
 };
 
 
@@ -145,6 +152,11 @@ public:
     // Commit the current create or write and close the write file.
     void commit();
 
+    // Instead of replacing the original file with this one, write inData into the
+    // original file at inOffset, sync it, and discard this file.  The caller must
+    // only ever write past the data that readers of the original file rely on.
+    void commitAppend(off_t inOffset, const uint8 *inData, size_t inLength);
+
     void write(AtomicFile::OffsetType inOffsetType, off_t inOffset, const uint32 *inData, uint32 inCount);
     void write(AtomicFile::OffsetType inOffsetType, off_t inOffset, const uint8 *inData, size_t inLength);
     void write(AtomicFile::OffsetType inOffsetType, off_t inOffset, const uint32 inData);
@@ -156,6 +168,9 @@ private:
 	// Fsync the file
 	void fsync();
 
+	// Write all of inData to fileRef at inOffset.
+	void writeFully(int fileRef, const string &path, off_t inOffset, const uint8 *inData, size_t inLength);
+
 	// Close the file
 	void close();
 
@@ -109,6 +109,15 @@ DbIndexKey::operator < (const DbIndexKey &other) const
 	return false;
 }
 
+uint32
+DbIndexKey::hash() const
+{
+	return mIndex.hashKey(mKeySection.subsection(mKeyRange), 0, (uint32) mIndex.mAttributes.size());
+}
+
+const uint32 DbIndex::kHashDirectoryMagic;
+const uint32 DbIndex::kHashSlotAtoms;
+
 DbIndex::DbIndex(const MetaRecord &metaRecord, uint32 indexId, bool isUniqueIndex)
 :	mMetaRecord(metaRecord),
 	mIndexId(indexId),
@@ -116,6 +125,16 @@ DbIndex::DbIndex(const MetaRecord &metaRecord, uint32 indexId, bool isUniqueInde
 {
 }
 
+uint32
+DbIndex::hashKey(const ReadSection &key, uint32 offset, uint32 numValues) const
+{
+	uint32 hash = DbValue::kHashSeed;
+	for (uint32 i = 0; i < numValues; i++)
+		hash = mAttributes[i]->hashValue(key, offset, hash);
+
+	return hash;
+}
+
 // Append an attribute to the vector used to form index keys.
 
 void
@@ -132,12 +151,14 @@ DbIndex::appendAttribute(uint32 attributeId)
 
 DbConstIndex::DbConstIndex(const Table &table, uint32 indexId, bool isUniqueIndex)
 :	DbIndex(table.getMetaRecord(), indexId, isUniqueIndex),
+	mHashMask(0),
 	mTable(table)
 {
 }
 
 DbConstIndex::DbConstIndex(const Table &table, const ReadSection &indexSection)
 :	DbIndex(table.getMetaRecord(), indexSection.at(AtomSize), indexSection.at(2 * AtomSize)),
+	mHashMask(0),
 	mTable(table)
 {
 	uint32 numAttributes = indexSection.at(3 * AtomSize);
@@ -156,6 +177,23 @@ DbConstIndex::DbConstIndex(const Table &table, const ReadSection &indexSection)
 	offset += numRecords * AtomSize;
 	mRecordNumberVector.overlay(numRecords,
 		reinterpret_cast<const Atom *>(indexSection.range(Range(offset, numRecords * AtomSize))));
+
+	// pick up the hash directory, if this index was written with one; in an
+	// index without one, the atom here is the size of the first key (or past
+	// the end of the index)
+	offset += numRecords * AtomSize;
+	uint32 indexSize = indexSection.at(0);
+	if (CheckUInt32Add(offset, 2 * AtomSize) <= indexSize && indexSection.at(offset) == kHashDirectoryMagic) {
+		uint32 numSlots = indexSection.at(offset + AtomSize);
+		offset += 2 * AtomSize;
+		if (numSlots == 0 || (numSlots & (numSlots - 1)) != 0 ||
+			numSlots > (indexSize - offset) / (kHashSlotAtoms * AtomSize))
+			CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
+
+		mHashSlotVector.overlay(numSlots * kHashSlotAtoms,
+			reinterpret_cast<const Atom *>(indexSection.range(Range(offset, numSlots * kHashSlotAtoms * AtomSize))));
+		mHashMask = numSlots - 1;
+	}
 }
 
 // Check to see if this index can be used to perform a given query, based on
@@ -264,7 +302,9 @@ DbConstIndex::performQuery(const DbQueryKey &queryKey,
 	switch (queryKey.mOp) {
 	
 	case CSSM_DB_EQUAL:
-		{
+		if (findHashedKey(queryKey, begin, end))
+			break;
+		else {
 			pair<DbIndexIterator, DbIndexIterator> result;
 			result = equal_range(mKeyOffsetVector.begin(), mKeyOffsetVector.end(),
 				DbKeyComparator::kUseQueryKeyOffset, cmp);
@@ -290,6 +330,47 @@ DbConstIndex::performQuery(const DbQueryKey &queryKey,
 	}
 }
 
+// Look up an equality query on every attribute of the index in the hash
+// directory. Returns false if the directory can't answer the query, in which
+// case the caller falls back to a binary search of the sorted key vector.
+
+bool
+DbConstIndex::findHashedKey(const DbQueryKey &queryKey,
+	DbIndexIterator &begin, DbIndexIterator &end) const
+{
+	if (mHashSlotVector.empty() || queryKey.mNumKeyValues != mAttributes.size())
+		return false;
+
+	DbKeyComparator cmp(queryKey);
+	uint32 hash = hashKey(queryKey.mKeyData, sizeof(uint32), queryKey.mNumKeyValues);
+
+	begin = end = mKeyOffsetVector.end();
+	for (uint32 probe = 0; probe <= mHashMask; probe++) {
+		uint32 slot = ((hash + probe) & mHashMask) * kHashSlotAtoms;
+		uint32 position = mHashSlotVector[slot + 1];
+		if (position == 0)
+			break;
+
+		if (mHashSlotVector[slot] != hash)
+			continue;
+
+		position--;
+		uint32 count = mHashSlotVector[slot + 2];
+		if (CheckUInt32Add(position, count) > mKeyOffsetVector.size())
+			CssmError::throwMe(CSSMERR_DL_DATABASE_CORRUPT);
+
+		uint32 keyOffset = mKeyOffsetVector[position];
+		if (!cmp(keyOffset, DbKeyComparator::kUseQueryKeyOffset) &&
+			!cmp(DbKeyComparator::kUseQueryKeyOffset, keyOffset)) {
+			begin = mKeyOffsetVector.begin() + position;
+			end = begin + count;
+			break;
+		}
+	}
+
+	return true;
+}
+
 // Given an iterator as returned by performQuery(), return the read section for the record.
 
 ReadSection
@@ -299,30 +380,20 @@ DbConstIndex::getRecordSection(DbIndexIterator iter) const
 	return mTable.getRecordSection(recordNumber);
 }
 
-// Construct a mutable index from a read-only index.
+// Construct a mutable index from a read-only index. The entries of the
+// read-only index stay where they are; see writeIndex().
 
 DbMutableIndex::DbMutableIndex(const DbConstIndex &index)
 :	DbIndex(index),
-	mIndexDataSize(0)
+	mIndexDataSize(0),
+	mConstIndex(&index)
 {
-	// go through the const index and copy all the entries into the
-	// mutable index
-	
-	const ReadSection &tableSection = index.mTable.getTableSection();
-	
-	size_t numRecords = index.mKeyOffsetVector.size();
-	for (size_t i = 0; i < numRecords; i++) {
-		uint32 recordNumber = index.mRecordNumberVector.at(i);
-		uint32 keyOffset = index.mKeyOffsetVector.at(i);
-		uint32 keySize = tableSection.at(keyOffset);
-		DbIndexKey key(tableSection, Range(keyOffset + AtomSize, keySize), *this);
-		mMap.insert(IndexMap::value_type(key, recordNumber));
-	}
 }
 
 DbMutableIndex::DbMutableIndex(const MetaRecord &metaRecord, uint32 indexId, bool isUniqueIndex)
 :	DbIndex(metaRecord, indexId, isUniqueIndex),
-	mIndexDataSize(0)
+	mIndexDataSize(0),
+	mConstIndex(NULL)
 {
 }
 
@@ -330,14 +401,52 @@ DbMutableIndex::~DbMutableIndex()
 {
 }
 
-// Remove all entries for a record from an index. This is not an ideal implementation,
-// since it walks the entire index. In a perfect world, we'd generate all the record's
-// keys and lookup matching entries, deleting only those with the correct record number.
-// But this is not a perfect world.
+// Return the key of the entry at a given position in the read-only index.
+
+DbIndexKey
+DbMutableIndex::constKey(uint32 position) const
+{
+	const ReadSection &tableSection = mConstIndex->mTable.getTableSection();
+	uint32 keyOffset = mConstIndex->mKeyOffsetVector.at(position);
+	uint32 keySize = tableSection.at(keyOffset);
+	return DbIndexKey(tableSection, Range(keyOffset + AtomSize, keySize), *this);
+}
+
+// Check whether the read-only index has a live (not removed) entry for a key.
+
+bool
+DbMutableIndex::constIndexContains(const DbIndexKey &key) const
+{
+	if (mConstIndex == NULL)
+		return false;
+
+	// find the first entry not less than key
+	uint32 low = 0, high = (uint32) mConstIndex->mKeyOffsetVector.size();
+	while (low < high) {
+		uint32 middle = low + (high - low) / 2;
+		if (constKey(middle) < key)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for (; low < mConstIndex->mKeyOffsetVector.size() && !(key < constKey(low)); low++)
+		if (mRemovedRecords.find(mConstIndex->mRecordNumberVector.at(low)) == mRemovedRecords.end())
+			return true;
+
+	return false;
+}
+
+// Remove all entries for a record from an index. Entries in the read-only index
+// are dropped when the index is written; entries inserted since are erased now,
+// which walks only the records inserted in this transaction.
 
 void
 DbMutableIndex::removeRecord(uint32 recordNumber)
 {
+	if (mConstIndex != NULL)
+		mRemovedRecords.insert(recordNumber);
+
 	IndexMap::iterator it, temp;
 	for (it = mMap.begin(); it != mMap.end(); ) {
 		temp = it; it++;
@@ -393,16 +502,8 @@ DbMutableIndex::insertRecordSingle(uint32 recordNumber, const ReadSection &packe
 		mAttributes[i]->copyValueBytes(0, packedRecord, mIndexData, mIndexDataSize);
 	mIndexData.size(mIndexDataSize);
 		
-	// make an index key
-	DbIndexKey key(mIndexData, Range(offset, mIndexDataSize - offset), *this);
-	
-	// if this is a unique index, check for a record with the same key
-	if (mIsUniqueIndex && (mMap.find(key) != mMap.end()))
-		// the key already exists, which is an error
-		CssmError::throwMe(CSSMERR_DL_INVALID_UNIQUE_INDEX_DATA);
-		
-	// insert the item into the map
-	mMap.insert(IndexMap::value_type(key, recordNumber));
+	// make an index key and insert it
+	insertKey(DbIndexKey(mIndexData, Range(offset, mIndexDataSize - offset), *this), recordNumber);
 }
 
 void
@@ -422,11 +523,7 @@ DbMutableIndex::insertRecordMulti(uint32 recordNumber, const ReadSection &packed
 			mIndexDataSize = mIndexData.put(mIndexDataSize, newKeySize, keyData.address());
 			mIndexData.size(mIndexDataSize);
 
-			DbIndexKey key(mIndexData, Range(offset, mIndexDataSize - offset), *this);
-			if (mIsUniqueIndex && (mMap.find(key) != mMap.end()))
-				CssmError::throwMe(CSSMERR_DL_INVALID_UNIQUE_INDEX_DATA);
-
-			mMap.insert(IndexMap::value_type(key, recordNumber));
+			insertKey(DbIndexKey(mIndexData, Range(offset, mIndexDataSize - offset), *this), recordNumber);
 		}
 		else
 			// otherwise, recurse with the rest of the attributes
@@ -434,11 +531,77 @@ DbMutableIndex::insertRecordMulti(uint32 recordNumber, const ReadSection &packed
 	}
 }
 
+void
+DbMutableIndex::insertKey(const DbIndexKey &key, uint32 recordNumber)
+{
+	// if this is a unique index, check for a record with the same key
+	if (mIsUniqueIndex && (mMap.find(key) != mMap.end() || constIndexContains(key)))
+		// the key already exists, which is an error
+		CssmError::throwMe(CSSMERR_DL_INVALID_UNIQUE_INDEX_DATA);
+
+	// insert the item into the map
+	mMap.insert(IndexMap::value_type(key, recordNumber));
+}
+
 uint32
 DbMutableIndex::writeIndex(WriteSection &ws, uint32 offset)
 {
-	IndexMap::iterator it;
+	// merge the surviving entries of the read-only index with the inserted
+	// ones; both are already sorted, so this is a single pass
+	vector<DbIndexKey> keys;
+	vector<uint32> recordNumbers;
+	
+	uint32 numConstEntries = mConstIndex ? (uint32) mConstIndex->mKeyOffsetVector.size() : 0;
+	keys.reserve(numConstEntries + mMap.size());
+	recordNumbers.reserve(numConstEntries + mMap.size());
+	
+	IndexMap::iterator it = mMap.begin();
+	for (uint32 i = 0; i < numConstEntries; i++) {
+		uint32 recordNumber = mConstIndex->mRecordNumberVector.at(i);
+		if (mRemovedRecords.find(recordNumber) != mRemovedRecords.end())
+			continue;
+
+		DbIndexKey key(constKey(i));
+		for (; it != mMap.end() && it->first < key; it++) {
+			keys.push_back(it->first);
+			recordNumbers.push_back(it->second);
+		}
+		keys.push_back(key);
+		recordNumbers.push_back(recordNumber);
+	}
+	for (; it != mMap.end(); it++) {
+		keys.push_back(it->first);
+		recordNumbers.push_back(it->second);
+	}
 	
+	uint32 numEntries = (uint32) keys.size();
+
+	// build the hash directory: one slot per run of equal keys, in a table at
+	// most half full
+	vector<uint32> runStarts;
+	for (uint32 i = 0; i < numEntries; i++)
+		if (i == 0 || keys[i - 1] < keys[i])
+			runStarts.push_back(i);
+
+	uint32 numSlots = 1;
+	while (numSlots < 2 * runStarts.size())
+		numSlots <<= 1;
+
+	vector<uint32> slots(numSlots * kHashSlotAtoms, 0);
+	for (uint32 run = 0; run < runStarts.size(); run++) {
+		uint32 position = runStarts[run];
+		uint32 count = ((run + 1 < runStarts.size()) ? runStarts[run + 1] : numEntries) - position;
+		uint32 hash = keys[position].hash();
+
+		uint32 slot = hash & (numSlots - 1);
+		while (slots[slot * kHashSlotAtoms + 1] != 0)
+			slot = (slot + 1) & (numSlots - 1);
+
+		slots[slot * kHashSlotAtoms] = hash;
+		slots[slot * kHashSlotAtoms + 1] = position + 1;
+		slots[slot * kHashSlotAtoms + 2] = count;
+	}
+
 	// reserve space for the index size
 	uint32 sizeOffset = offset;
 	offset += AtomSize;
@@ -450,22 +613,27 @@ DbMutableIndex::writeIndex(WriteSection &ws, uint32 offset)
 	for (uint32 i = 0; i < mAttributes.size(); i++)
 		offset = ws.put(offset, mAttributes[i]->attributeId());
 
-	offset = ws.put(offset, (uint32)mMap.size());
+	offset = ws.put(offset, numEntries);
 	
 	// reserve space for the array of offsets to key data
 	uint32 keyPtrOffset = offset;
-	offset += AtomSize * mMap.size();
+	offset += AtomSize * numEntries;
 	
 	// write the array of record numbers
-	for (it = mMap.begin(); it != mMap.end(); it++) {
-		offset = ws.put(offset, it->second);
-	}
+	for (uint32 i = 0; i < numEntries; i++)
+		offset = ws.put(offset, recordNumbers[i]);
+
+	// write the hash directory
+	offset = ws.put(offset, kHashDirectoryMagic);
+	offset = ws.put(offset, numSlots);
+	for (uint32 i = 0; i < slots.size(); i++)
+		offset = ws.put(offset, slots[i]);
 		
 	// write the key data
-	for (it = mMap.begin(); it != mMap.end(); it++) {
+	for (uint32 i = 0; i < numEntries; i++) {
 		keyPtrOffset = ws.put(keyPtrOffset, offset);
-		offset = ws.put(offset, it->first.keySize());
-		offset = ws.put(offset, it->first.keySize(), it->first.keyData());
+		offset = ws.put(offset, keys[i].keySize());
+		offset = ws.put(offset, keys[i].keySize(), keys[i].keyData());
 	}
 	
 	// write the index size
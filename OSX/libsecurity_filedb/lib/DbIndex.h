@@ -24,6 +24,7 @@
 #define _H_APPLEDL_DBINDEX
 
 #include "MetaRecord.h"
+#include <set>
 
 namespace Security
 {
@@ -86,6 +87,9 @@ public:
 		: mKeySection(key), mKeyRange(keyRange), mIndex(index) {}
 
 	bool operator < (const DbIndexKey &other) const;
+
+	// hash of the key values, as stored in an index's hash directory
+	uint32 hash() const;
 	
 	uint32 keySize() const { return mKeyRange.mSize; }
 	const uint8 *keyData() const { return mKeySection.range(mKeyRange); }
@@ -111,9 +115,21 @@ public:
 	// append an attribute to the index key
 	void appendAttribute(uint32 attributeId);
 
+	// An index may carry a hash directory, stored between the record number
+	// vector and the key data, that maps full-key hashes to runs of equal keys.
+	// Readers that predate it only follow the key offset vector, so it is
+	// invisible to them.
+	static const uint32 kHashDirectoryMagic = 0x68736864; // 'hshd'
+	
+	// each slot is (key hash, position of the first entry + 1, entry count)
+	static const uint32 kHashSlotAtoms = 3;
+
 protected:
 	DbIndex(const MetaRecord &metaRecord, uint32 indexId, bool isUniqueIndex);
 
+	// hash the first numValues attribute values of a key starting at offset
+	uint32 hashKey(const ReadSection &key, uint32 offset, uint32 numValues) const;
+
 	// meta record for table associated with this index
 	const MetaRecord &mMetaRecord;
 
@@ -151,16 +167,27 @@ public:
 	ReadSection getRecordSection(DbIndexIterator iter) const;
 
 private:
+	// look up an exact match on all key attributes in the hash directory
+	bool findHashedKey(const DbQueryKey &queryKey,
+		DbIndexIterator &begin, DbIndexIterator &end) const;
+
 	// sorted vector of offsets to index key data
 	DbOffsetVector mKeyOffsetVector;
 	
 	// vector, in same order as key vector, of corresponding record numbers
 	DbOffsetVector mRecordNumberVector;
 
+	// hash directory slots, or empty if the index was written without one
+	DbOffsetVector mHashSlotVector;
+	uint32 mHashMask;
+
 	const Table &mTable;
 };
 
 // A memory-resident index that can be modified, but not used for a query.
+// When created from a read-only index, the entries of that index are left in
+// place; only the records inserted and removed since are tracked, and the two
+// are merged when the index is written.
 
 class DbMutableIndex : public DbIndex
 {
@@ -183,14 +210,24 @@ private:
 	void insertRecordSingle(uint32 recordOffset, const ReadSection &packedRecord);
 	void insertRecordMulti(uint32 recordOffset, const ReadSection &packedRecord,
 		uint32 attributeIndex, WriteSection &keyData, uint32 keySize);
+	void insertKey(const DbIndexKey &key, uint32 recordNumber);
+
+	// helpers for the entries inherited from the read-only index
+	DbIndexKey constKey(uint32 position) const;
+	bool constIndexContains(const DbIndexKey &key) const;
 
 	// a single write section which stores generated index key data
 	WriteSection mIndexData;
 	uint32 mIndexDataSize;
 	
-	// a map from index keys to record numbers
+	// a map from index keys to record numbers, for records inserted into this index
 	typedef multimap<DbIndexKey, uint32> IndexMap;
 	IndexMap mMap;
+
+	// the read-only index this one was created from, if any, and the records
+	// whose entries in it have been removed
+	const DbConstIndex *mConstIndex;
+	set<uint32> mRemovedRecords;
 };
 
 } // end namespace Security
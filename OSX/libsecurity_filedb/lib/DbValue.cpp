@@ -31,6 +31,17 @@ DbValue::~DbValue()
 {
 }
 
+const uint32 DbValue::kHashSeed;
+
+uint32
+DbValue::hashBytes(const uint8 *inData, size_t inLength, uint32 hash)
+{
+	for (size_t i = 0; i < inLength; i++)
+		hash = (hash ^ inData[i]) * 16777619U;
+
+	return hash;
+}
+
 //
 // UInt32Value
 //
@@ -143,6 +154,14 @@ DoubleValue::pack(WriteSection &ws, uint32 &offset) const
 	offset = ws.put(offset, (uint32)size(), bytes());
 }
 
+uint32
+DoubleValue::hash(uint32 hash) const
+{
+	// 0.0 and -0.0 compare equal but have different bit patterns.
+	double value = (mValue == 0.0) ? 0.0 : mValue;
+	return hashBytes(reinterpret_cast<const uint8 *>(&value), sizeof(value), hash);
+}
+
 //
 // BlobValue
 //
@@ -186,6 +205,14 @@ BlobValue::evaluate(const BlobValue &other, CSSM_DB_OPERATOR op) const
 	return evaluate(*this, other, op, Comparator());
 }
 
+uint32
+BlobValue::hash(uint32 hash) const
+{
+	uint32 length = (uint32)Length;
+	hash = hashBytes(reinterpret_cast<const uint8 *>(&length), sizeof(length), hash);
+	return hashBytes(Data, Length, hash);
+}
+
 bool
 BlobValue::evaluate(const CssmData &inData1, const CssmData &inData2, CSSM_DB_OPERATOR op,
 	Comparator compare)
@@ -357,6 +384,19 @@ StringValue::evaluate(const StringValue &other, CSSM_DB_OPERATOR op) const
 	return BlobValue::evaluate(*this, other, op, StringValue::Comparator());
 }
 
+// BlobValue::evaluate() takes its Comparator by value, so StringValue's
+// strncmp() comparator is sliced off and strings actually compare with
+// memcmp(). Hashing only up to the first NUL keeps equal keys hashing
+// equally under either comparison.
+
+uint32
+StringValue::hash(uint32 hash) const
+{
+	uint32 length = (uint32)Length;
+	hash = hashBytes(reinterpret_cast<const uint8 *>(&length), sizeof(length), hash);
+	return hashBytes(Data, Length ? strnlen(reinterpret_cast<const char *>(Data), Length) : 0, hash);
+}
+
 //
 // BigNumValue
 //
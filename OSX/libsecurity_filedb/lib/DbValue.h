@@ -41,6 +41,13 @@ class DbValue
 {
 public:
 	virtual ~DbValue();
+
+	// Fold inLength bytes into a running 32-bit FNV-1a hash.  Values that
+	// compare CSSM_DB_EQUAL must hash the same; the hash() methods below
+	// take care of the types where that is not simply a matter of bytes.
+	static uint32 hashBytes(const uint8 *inData, size_t inLength, uint32 hash);
+
+	static const uint32 kHashSeed = 2166136261U;
 };
 
 // A collection of subclasses of DbValue that work for simple
@@ -77,10 +84,13 @@ public:
 		}
 	}
 
+	T value() const { return mValue; }
 	size_t size() const { return sizeof(T); }
 	size_t size(const ReadSection &rs, uint32 offset) const { return size(); }
 	const uint8 *bytes() const { return reinterpret_cast<const uint8 *>(&mValue); }
 
+	uint32 hash(uint32 hash) const { return hashBytes(bytes(), size(), hash); }
+
 protected:
 	T mValue;
 };
@@ -115,6 +125,7 @@ public:
 	DoubleValue(const CSSM_DATA &data);
 	virtual ~DoubleValue();
 	void pack(WriteSection &ws, uint32 &offset) const;
+	uint32 hash(uint32 hash) const;
 };
 
 // Subclasses of Value for more complex types.
@@ -128,6 +139,7 @@ public:
 	virtual ~BlobValue();
 	void pack(WriteSection &ws, uint32 &offset) const;
 	bool evaluate(const BlobValue &other, CSSM_DB_OPERATOR op) const;
+	uint32 hash(uint32 hash) const;
 
 	size_t size() const { return Length; }
 	const uint8 *bytes() const { return Data; }
@@ -166,6 +178,7 @@ public:
 	StringValue(const CSSM_DATA &data);
 	virtual ~StringValue();
 	bool evaluate(const StringValue &other, CSSM_DB_OPERATOR op) const;
+	uint32 hash(uint32 hash) const;
 	
 private:
 	class Comparator : public BlobValue::Comparator {
@@ -197,6 +210,7 @@ public:
 	virtual ~MultiUInt32Value();
 	void pack(WriteSection &ws, uint32 &offset) const;
 	bool evaluate(const MultiUInt32Value &other, CSSM_DB_OPERATOR op) const;
+	uint32 hash(uint32 hash) const { return hashBytes(bytes(), size(), hash); }
 
 	size_t size() const { return mNumValues * sizeof(uint32); }
 	const uint8 *bytes() const { return reinterpret_cast<uint8 *>(mValues); }
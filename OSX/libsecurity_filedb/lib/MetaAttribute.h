@@ -66,6 +66,7 @@ public:
 		uint32 &writeOffset) const = 0;
 	virtual bool evaluate(const DbValue *value, const ReadSection &rs, CSSM_DB_OPERATOR op) const = 0;
 	virtual bool evaluate(const DbValue *value1, const DbValue *value2, CSSM_DB_OPERATOR op) const = 0;
+	virtual uint32 hashValue(const ReadSection &rs, uint32 &offset, uint32 hash) const = 0;
 	virtual uint32 parse(const CssmData &inData, CSSM_DATA_PTR &outValues) const = 0;
 
 protected:
@@ -150,6 +151,12 @@ public:
 	{
 		return (dynamic_cast<const T *>(value1))->evaluate(*dynamic_cast<const T *>(value2), op);
 	}
+
+	uint32 hashValue(const ReadSection &rs, uint32 &offset, uint32 hash) const
+	{
+		T value(rs, offset);
+		return value.hash(hash);
+	}
 		
     uint32 parse(const CssmData &inData, CSSM_DATA_PTR &outValues) const
 	{
@@ -148,6 +148,7 @@ private:
                          CSSM_DB_ATTRIBUTE_DATA &inoutAttribute) const;
 
     friend class MetaAttribute;
+    friend class SelectionPredicate;
 	enum
 	{
 		OffsetRecordSize			= AtomSize * 0,
@@ -37,6 +37,55 @@ SelectionPredicate::SelectionPredicate(const MetaRecord &inMetaRecord,
 
 	mData = inPredicate.Attribute.Value[0];
 	mValue = mMetaAttribute.createValue(mData);
+
+	mPlan = kPlanGeneric;
+	mAttributeOffset = MetaRecord::OffsetAttributeOffsets + mMetaAttribute.attributeIndex() * AtomSize;
+	mUInt32 = 0;
+
+	switch (mMetaAttribute.attributeFormat())
+	{
+	case CSSM_DB_ATTRIBUTE_FORMAT_UINT32:
+	case CSSM_DB_ATTRIBUTE_FORMAT_SINT32:
+		switch (mDbOperator)
+		{
+		case CSSM_DB_EQUAL:
+		case CSSM_DB_NOT_EQUAL:
+		case CSSM_DB_LESS_THAN:
+		case CSSM_DB_GREATER_THAN:
+			if (mMetaAttribute.attributeFormat() == CSSM_DB_ATTRIBUTE_FORMAT_UINT32)
+			{
+				mPlan = kPlanUInt32;
+				mUInt32 = static_cast<UInt32Value *>(mValue)->value();
+			}
+			else
+			{
+				mPlan = kPlanSInt32;
+				mUInt32 = static_cast<uint32>(static_cast<SInt32Value *>(mValue)->value());
+			}
+			break;
+		default:
+			break;
+		}
+		break;
+
+	case CSSM_DB_ATTRIBUTE_FORMAT_STRING:
+	case CSSM_DB_ATTRIBUTE_FORMAT_BLOB:
+		switch (mDbOperator)
+		{
+		case CSSM_DB_EQUAL:
+		case CSSM_DB_NOT_EQUAL:
+		case CSSM_DB_CONTAINS_INITIAL_SUBSTRING:
+		case CSSM_DB_CONTAINS_FINAL_SUBSTRING:
+			mPlan = kPlanBytes;
+			break;
+		default:
+			break;
+		}
+		break;
+
+	default:
+		break;
+	}
 }
 
 SelectionPredicate::~SelectionPredicate()
@@ -47,5 +96,106 @@ SelectionPredicate::~SelectionPredicate()
 bool
 SelectionPredicate::evaluate(const ReadSection &rs) const
 {
-    return mMetaAttribute.evaluate(mValue, rs, mDbOperator);
+	if (mPlan == kPlanGeneric)
+		return mMetaAttribute.evaluate(mValue, rs, mDbOperator);
+
+	// This mirrors MetaAttribute::unpackNumberOfValues().
+	uint32 numValues;
+	uint32 offset = rs[mAttributeOffset];
+	if (offset == 0)
+		return false;
+	else if (offset & 1) {
+		offset ^= 1;
+		numValues = 1;
+	}
+	else {
+		numValues = rs[offset];
+		offset += AtomSize;
+	}
+
+	// As with MetaAttribute::evaluate(), any matching value is a match.
+	for (uint32 ix = 0; ix < numValues; ++ix)
+		if (evaluateValue(rs, offset))
+			return true;
+
+	return false;
+}
+
+// Evaluate the value at ioOffset in rs and advance ioOffset past it.  The
+// comparisons are the same as those of the corresponding DbValue::evaluate(),
+// with mValue on the left hand side.
+
+bool
+SelectionPredicate::evaluateValue(const ReadSection &rs, uint32 &ioOffset) const
+{
+	switch (mPlan)
+	{
+	case kPlanUInt32:
+	{
+		uint32 value = rs.at(ioOffset);
+		ioOffset += AtomSize;
+		switch (mDbOperator)
+		{
+		case CSSM_DB_EQUAL:			return mUInt32 == value;
+		case CSSM_DB_NOT_EQUAL:		return mUInt32 != value;
+		case CSSM_DB_LESS_THAN:		return mUInt32 < value;
+		default:					return mUInt32 > value;
+		}
+	}
+
+	case kPlanSInt32:
+	{
+		sint32 query = static_cast<sint32>(mUInt32);
+		sint32 value = static_cast<sint32>(rs.at(ioOffset));
+		ioOffset += AtomSize;
+		switch (mDbOperator)
+		{
+		case CSSM_DB_EQUAL:			return query == value;
+		case CSSM_DB_NOT_EQUAL:		return query != value;
+		case CSSM_DB_LESS_THAN:		return query < value;
+		default:					return query > value;
+		}
+	}
+
+	case kPlanBytes:
+	{
+		// Same layout as BlobValue(const ReadSection &, uint32 &).
+		uint32 length = rs.at(ioOffset);
+		const uint8 *data = rs.range(Range(ioOffset + AtomSize, length));
+		ioOffset = ReadSection::align(ioOffset + length + AtomSize);
+		return evaluateBytes(data, length);
+	}
+
+	default:
+		CssmError::throwMe(CSSM_ERRCODE_INTERNAL_ERROR);
+	}
+}
+
+// BlobValue::evaluate() passes its Comparator by value, so strings end up
+// being compared with memcmp() just like blobs; do the same here.
+
+bool
+SelectionPredicate::evaluateBytes(const uint8 *data, uint32 length) const
+{
+	uint32 queryLength = (uint32)mData.Length;
+	const uint8 *queryData = mData.Data;
+
+	switch (mDbOperator)
+	{
+	case CSSM_DB_CONTAINS_INITIAL_SUBSTRING:
+		return queryLength <= length
+			&& (queryLength == 0 || memcmp(queryData, data, queryLength) == 0);
+
+	case CSSM_DB_CONTAINS_FINAL_SUBSTRING:
+		return queryLength <= length
+			&& (queryLength == 0 || memcmp(queryData, data + (length - queryLength), queryLength) == 0);
+
+	case CSSM_DB_EQUAL:
+		return queryLength == length
+			&& (length == 0 || memcmp(queryData, data, length) == 0);
+
+	default:	// CSSM_DB_NOT_EQUAL
+		return queryLength != length
+			|| (length != 0 && memcmp(queryData, data, length) != 0);
+	}
 }
@@ -41,10 +41,28 @@ public:
     bool evaluate(const ReadSection &inReadSection) const;
 	
 private:
+	// How evaluate() matches a record.  The common comparisons are compiled
+	// into checks made directly on the packed values in the record; anything
+	// else is handed to mMetaAttribute, which unpacks each value as a DbValue.
+	enum Plan
+	{
+		kPlanGeneric,
+		kPlanUInt32,		// uint32 compared with mUInt32
+		kPlanSInt32,		// sint32 compared with (sint32)mUInt32
+		kPlanBytes			// length prefixed bytes compared with mData
+	};
+
+	bool evaluateValue(const ReadSection &inReadSection, uint32 &ioOffset) const;
+	bool evaluateBytes(const uint8 *inData, uint32 inLength) const;
+
     const MetaAttribute &mMetaAttribute;
     CSSM_DB_OPERATOR mDbOperator;
 	CssmDataContainer mData;
 	DbValue *mValue;
+
+	Plan mPlan;
+	uint32 mAttributeOffset;	// offset of this attribute's value offset in a record
+	uint32 mUInt32;
 };
 
 } // end namespace Security
@@ -1109,6 +1109,48 @@ static void testIterateLockedKeychain(void) {
 }
 #define testIterateLockedKeychainTests (openCustomKeychainTests + 1 + checkNTests*5 + 1)
 
+static CFMutableDictionaryRef createQueryAccountDictionary(SecKeychainRef kc, CFStringRef account) {
+    CFMutableDictionaryRef query = createQueryItemDictionary(kc, kSecClassGenericPassword);
+    CFDictionarySetValue(query, kSecAttrAccount, account);
+    return query;
+}
+
+// full_v512 was written before indexes carried a hash directory. Exact
+// lookups must work on it as is, and again once a commit rewrites its
+// indexes in the new layout.
+static void testOldIndexFormat(void) {
+    char name[100];
+    snprintf(name, sizeof(name), "testOldIndexFormat");
+    secnotice("integrity", "************************************* %s", name);
+
+    SecKeychainItemRef item = NULL;
+
+    unlink(keychainFile);
+    writeFullV512Keychain(name, keychainDbFile);
+
+    SecKeychainRef kc = openCustomKeychain(name, keychainName, "password");
+
+    checkN(name, createQueryAccountDictionary(kc, CFSTR("test_account")), 1);
+    checkN(name, createQueryAccountDictionary(kc, CFSTR("no_such_account")), 0);
+
+    // adding an item rewrites the indexes
+    item = createCustomItem(name, kc, createAddCustomItemDictionary(kc, kSecClassGenericPassword, CFSTR("test_generic_2"), CFSTR("test_account_2")));
+    CFReleaseNull(item);
+    CFReleaseNull(kc);
+
+    kc = openCustomKeychain(name, keychainName, "password");
+
+    checkN(name, createQueryAccountDictionary(kc, CFSTR("test_account")), 1);
+    checkN(name, createQueryAccountDictionary(kc, CFSTR("test_account_2")), 1);
+    checkN(name, createQueryAccountDictionary(kc, CFSTR("no_such_account")), 0);
+    makeCustomDuplicateItem(name, kc, kSecClassGenericPassword, CFSTR("test_generic"));
+
+    ok_status(SecKeychainDelete(kc), "%s: SecKeychainDelete", name);
+    CFReleaseNull(kc);
+}
+#define testOldIndexFormatTests (openCustomKeychainTests + checkNTests*2 + createCustomItemTests \
+       + openCustomKeychainTests + checkNTests*3 + makeCustomDuplicateItemTests + 1)
+
 #define kTestCount (0 \
        + testAddItemTests \
        + testAddItemTests \
@@ -1148,6 +1190,7 @@ static void testIterateLockedKeychain(void) {
        + testRootUidAccessTests \
        + testBadACLTests \
        + testIterateLockedKeychainTests \
+       + testOldIndexFormatTests \
        )
 
 static void tests(void)
@@ -1164,6 +1207,7 @@ static void tests(void)
     testRootUidAccess();
     testBadACL();
     testIterateLockedKeychain();
+    testOldIndexFormat();
 
     testAddItem(kSecClassGenericPassword,  CFSTR("265438ea6807b509c9c6962df3f5033fd1af118f76c5f550e3ed90cb0d3ffce4"));
     testAddItem(kSecClassInternetPassword, CFSTR("be34c4562153063ce9cdefc2c34451d5e6e98a447f293d68a67349c1b5d1164f"));
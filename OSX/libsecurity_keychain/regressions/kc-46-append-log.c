@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include "keychain_regressions.h"
+#include "kc-helpers.h"
+
+#include <Security/cssmapi.h>
+#include <Security/cssmapple.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+
+/* Test the AppleFileDL append log: commits to a database created with
+   kCSSM_APPLEDL_MASK_APPEND_LOG are appended to the file, survive a reopen,
+   and a torn tail is ignored on open and overwritten by the next commit
+   without the file ever shrinking. */
+
+#define kAppendLogRecordType    (CSSM_DB_RECORDTYPE_APP_DEFINED_START + 0x46)
+#define kAppendLogHeaderVersion 0x00010001
+#define kInitialRecords         5
+
+/* Standard memory functions required by CSSM. */
+static void *cssmMalloc(CSSM_SIZE size, void *allocRef) { return malloc(size); }
+static void cssmFree(void *mem_ptr, void *allocRef) { free(mem_ptr); return; }
+static void *cssmRealloc(void *ptr, CSSM_SIZE size, void *allocRef) { return realloc( ptr, size ); }
+static void *cssmCalloc(uint32 num, CSSM_SIZE size, void *allocRef) { return calloc( num, size ); }
+static CSSM_API_MEMORY_FUNCS memFuncs = { cssmMalloc, cssmFree, cssmRealloc, cssmCalloc, NULL };
+
+static CSSM_DL_DB_HANDLE initializeDL(void) {
+    CSSM_VERSION version = { 2, 0 };
+    CSSM_DL_DB_HANDLE dldbHandle = { 0, 0 };
+    CSSM_GUID myGuid = { 0xFADE, 0, 0, { 1, 2, 3, 4, 5, 6, 7, 0 } };
+    CSSM_PVC_MODE pvcPolicy = CSSM_PVC_NONE;
+
+    ok_status(CSSM_Init(&version, CSSM_PRIVILEGE_SCOPE_NONE, &myGuid, CSSM_KEY_HIERARCHY_NONE, &pvcPolicy, NULL), "cssm_init");
+    ok_status(CSSM_ModuleLoad(&gGuidAppleFileDL, CSSM_KEY_HIERARCHY_NONE, NULL, NULL), "module_load");
+    ok_status(CSSM_ModuleAttach(&gGuidAppleFileDL, &version, &memFuncs, 0, CSSM_SERVICE_DL, 0, CSSM_KEY_HIERARCHY_NONE, NULL, 0, NULL, &dldbHandle.DLHandle), "module_attach");
+
+    return dldbHandle;
+}
+#define initializeDLTests 3
+
+static void unloadDL(CSSM_DL_DB_HANDLE* dldbHandle) {
+    ok_status(CSSM_ModuleDetach(dldbHandle->DLHandle), "detach");
+    ok_status(CSSM_ModuleUnload(&gGuidAppleFileDL, NULL, NULL), "unload");
+    ok_status(CSSM_Terminate(), "terminate");
+}
+#define unloadDLTests 3
+
+static CSSM_DB_ATTRIBUTE_INFO labelInfo = {
+    CSSM_DB_ATTRIBUTE_NAME_AS_STRING, { (char *)"Label" }, CSSM_DB_ATTRIBUTE_FORMAT_STRING
+};
+
+static void createAppendLogDb(CSSM_DL_DB_HANDLE *dldbHandle, const char *path) {
+    CSSM_DB_RECORD_ATTRIBUTE_INFO attributeInfo = { kAppendLogRecordType, 1, &labelInfo };
+    CSSM_DB_RECORD_INDEX_INFO indexInfo = { kAppendLogRecordType, 0, NULL };
+    CSSM_DB_PARSING_MODULE_INFO parsingModule = { kAppendLogRecordType, {} };
+    CSSM_DBINFO dbInfo = {};
+    dbInfo.NumberOfRecordTypes = 1;
+    dbInfo.DefaultParsingModules = &parsingModule;
+    dbInfo.RecordAttributeNames = &attributeInfo;
+    dbInfo.RecordIndexes = &indexInfo;
+    dbInfo.IsLocal = CSSM_TRUE;
+
+    CSSM_APPLEDL_OPEN_PARAMETERS openParameters = {};
+    openParameters.length = sizeof(openParameters);
+    openParameters.version = CSSM_APPLEDL_OPEN_PARAMETERS_VERSION;
+    openParameters.autoCommit = CSSM_TRUE;
+    openParameters.mask = kCSSM_APPLEDL_MASK_MODE | kCSSM_APPLEDL_MASK_APPEND_LOG;
+    openParameters.mode = 0600;
+
+    ok_status(CSSM_DL_DbCreate(dldbHandle->DLHandle, path, NULL, &dbInfo,
+                   CSSM_DB_ACCESS_READ | CSSM_DB_ACCESS_WRITE,
+                   NULL, /* Credential template */
+                   &openParameters,
+                   &dldbHandle->DBHandle), "%s: CSSM_DL_DbCreate", testName);
+}
+#define createAppendLogDbTests 1
+
+static void openDb(CSSM_DL_DB_HANDLE *dldbHandle, const char *path) {
+    ok_status(CSSM_DL_DbOpen(dldbHandle->DLHandle, path,
+                   NULL,
+                   CSSM_DB_ACCESS_READ | CSSM_DB_ACCESS_WRITE,
+                   NULL, /* Access cred? */
+                   NULL, /* Open Parameters? */
+                   &dldbHandle->DBHandle), "%s: CSSM_DL_DbOpen", testName);
+}
+#define openDbTests 1
+
+static void closeDb(CSSM_DL_DB_HANDLE *dldbHandle) {
+    ok_status(CSSM_DL_DbClose(*dldbHandle), "%s: CSSM_DL_DbClose", testName);
+}
+#define closeDbTests 1
+
+/* All labels have the same length, so every insert appends a log record of the same size. */
+static void insertRecord(CSSM_DL_DB_HANDLE dldbHandle, int number) {
+    char label[16];
+    snprintf(label, sizeof(label), "record-%03d", number);
+    CSSM_DATA labelData = { strlen(label), (uint8 *)label };
+    CSSM_DB_ATTRIBUTE_DATA attributeData = { labelInfo, 1, &labelData };
+    CSSM_DB_RECORD_ATTRIBUTE_DATA attributes = { kAppendLogRecordType, 0, 1, &attributeData };
+    CSSM_DATA data = { strlen(label), (uint8 *)label };
+    CSSM_DB_UNIQUE_RECORD_PTR uniqueId = NULL;
+
+    ok_status(CSSM_DL_DataInsert(dldbHandle, kAppendLogRecordType, &attributes, &data, &uniqueId),
+              "%s: CSSM_DL_DataInsert %d", testName, number);
+    if (uniqueId) {
+        CSSM_DL_FreeUniqueRecord(dldbHandle, uniqueId);
+    }
+}
+#define insertRecordTests 1
+
+static uint32_t countRecords(CSSM_DL_DB_HANDLE dldbHandle) {
+    CSSM_QUERY queryAll = {};
+    queryAll.RecordType = kAppendLogRecordType;
+
+    CSSM_HANDLE results = 0;
+    CSSM_DB_UNIQUE_RECORD_PTR uniqueIdPtr = NULL;
+    uint32_t count = 0;
+
+    CSSM_RETURN status = CSSM_DL_DataGetFirst(dldbHandle, &queryAll, &results, NULL, NULL, &uniqueIdPtr);
+    while (status == CSSM_OK) {
+        count++;
+        CSSM_DL_FreeUniqueRecord(dldbHandle, uniqueIdPtr);
+        status = CSSM_DL_DataGetNext(dldbHandle, results, NULL, NULL, &uniqueIdPtr);
+    }
+    return count;
+}
+
+static off_t fileSize(const char *path) {
+    struct stat sb;
+    if (stat(path, &sb)) {
+        return -1;
+    }
+    return sb.st_size;
+}
+
+static uint32_t headerVersion(const char *path) {
+    uint32_t header[2] = { 0, 0 };
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        if (pread(fd, header, sizeof(header), 0) != sizeof(header)) {
+            header[1] = 0;
+        }
+        close(fd);
+    }
+    return ntohl(header[1]);
+}
+
+int kc_46_append_log(int argc, char *const *argv)
+{
+    plan_tests(initializeDLTests + createAppendLogDbTests + 1
+               + kInitialRecords * insertRecordTests + 1 + closeDbTests
+               + openDbTests + 1 + insertRecordTests + closeDbTests + 1
+               + openDbTests + 1 + closeDbTests
+               + openDbTests + 1 + insertRecordTests + closeDbTests + 1
+               + openDbTests + 1 + closeDbTests + 1 + unloadDLTests);
+
+    initializeKeychainTests(__FUNCTION__);
+    const char *path = keychainDbFile;
+    unlink(path);
+
+    CSSM_DL_DB_HANDLE dldbHandle = initializeDL();
+
+    createAppendLogDb(&dldbHandle, path);
+    is(headerVersion(path), (uint32_t)kAppendLogHeaderVersion, "%s: database uses the append log format", testName);
+
+    off_t sizes[kInitialRecords + 1];
+    sizes[0] = fileSize(path);
+    for (int i = 1; i <= kInitialRecords; i++) {
+        insertRecord(dldbHandle, i);
+        sizes[i] = fileSize(path);
+    }
+    off_t recordSize = sizes[kInitialRecords] - sizes[kInitialRecords - 1];
+    ok(recordSize > 0 && sizes[kInitialRecords] == sizes[0] + kInitialRecords * recordSize,
+       "%s: each commit appended one log record", testName);
+    closeDb(&dldbHandle);
+
+    // Garbage after the last complete record is ignored on open. The next
+    // commit is written over its start, and the rest stays in place: the file
+    // never shrinks under readers that have it mapped.
+    off_t goodSize = sizes[kInitialRecords];
+    int fd = open(path, O_WRONLY | O_APPEND);
+    uint8 garbage[4096];
+    memset(garbage, 0xa5, sizeof(garbage));
+    if (fd >= 0) {
+        (void)write(fd, garbage, sizeof(garbage));
+        close(fd);
+    }
+    openDb(&dldbHandle, path);
+    is(countRecords(dldbHandle), kInitialRecords, "%s: garbage tail ignored", testName);
+    insertRecord(dldbHandle, kInitialRecords + 1);
+    closeDb(&dldbHandle);
+    is(fileSize(path), goodSize + (off_t)sizeof(garbage), "%s: commit did not shrink the file", testName);
+    openDb(&dldbHandle, path);
+    is(countRecords(dldbHandle), kInitialRecords + 1, "%s: record written over the garbage tail", testName);
+    closeDb(&dldbHandle);
+
+    // A record that was only partly written is ignored on open, and the next
+    // commit is written over it. (Cutting the file here stands in for a crash
+    // during the append; it also drops what is left of the garbage.)
+    goodSize += recordSize;
+    (void)truncate(path, goodSize - 8);
+    openDb(&dldbHandle, path);
+    is(countRecords(dldbHandle), kInitialRecords, "%s: torn record ignored", testName);
+    insertRecord(dldbHandle, kInitialRecords + 2);
+    closeDb(&dldbHandle);
+    is(fileSize(path), goodSize, "%s: commit replaced the torn record", testName);
+
+    openDb(&dldbHandle, path);
+    is(countRecords(dldbHandle), kInitialRecords + 1, "%s: all complete records present after reopen", testName);
+    closeDb(&dldbHandle);
+    ok_status(CSSM_DL_DbDelete(dldbHandle.DLHandle, path, NULL, NULL), "%s: CSSM_DL_DbDelete", testName);
+
+    unloadDL(&dldbHandle);
+
+    deleteTestFiles();
+    return 0;
+}
+
+#pragma clang diagnostic pop
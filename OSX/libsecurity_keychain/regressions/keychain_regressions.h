@@ -44,6 +44,7 @@ ONE_TEST(kc_41_sececkey)
 ONE_TEST(kc_43_seckey_interop)
 ONE_TEST(kc_44_secrecoverypassword)
 ONE_TEST(kc_45_change_password)
+ONE_TEST(kc_46_append_log)
 ONE_TEST(si_20_certificate_copy_values)
 ONE_TEST(si_33_keychain_backup)
 ONE_TEST(si_34_one_true_keychain)
@@ -61,6 +61,7 @@ using namespace CssmClient;
  *     	 mdsObject.db		-- owner = <uid>, mode = 000, object DB
  *       mdsDirectory.db	-- owner = <uid>, mode = 000, MDS directory DB
  *	     mds.lock			-- owner = <uid>, protects updates of previous two files
+ *	     mds.scanstamp		-- owner = <uid>, fingerprint of the inputs to the last update
  * 
  * The /var/db/mds/system directory is created at OS install time. The DB files in 
  * it are created by root at MDS_Install time. The ownership and mode of this directory and
@@ -99,6 +100,7 @@ namespace Security
 #define MDS_USER_DB_COMP		"mds"
 
 #define MDS_LOCK_FILE_NAME		"mds.lock"			
+#define MDS_SCAN_STAMP_NAME		"mds.scanstamp"
 #define MDS_INSTALL_LOCK_NAME	"mds.install.lock"	
 #define MDS_OBJECT_DB_NAME		"mdsObject.db"
 #define MDS_DIRECT_DB_NAME		"mdsDirectory.db"
@@ -866,6 +868,191 @@ static bool checkUserBundles(
 	return rtn;
 }
 
+/*
+ * Scan stamp. After a successful updateDataBases() we record a fingerprint
+ * of everything that update depended on: the bundle directories together
+ * with every bundle in them, the system DB a user's DBs are copied from,
+ * every plugin path recorded in the object DB, and the DB files themselves.
+ * The recorded paths are kept in the stamp itself, after the fingerprint,
+ * so a later process can re-stat them without opening the DL. A process
+ * whose fingerprint matches can use the DBs as they are, without taking the
+ * lock or querying for each bundle.
+ *
+ * Everything but our own DB files is fingerprinted as it was before or
+ * while the update looked at it, never afterwards: something that changes
+ * during the update must not be stamped as already handled.
+ */
+static void scanStampMix(
+	uint64_t &hash,
+	const char *path,
+	const struct timespec &mtime)
+{
+	int64_t words[2] = { mtime.tv_sec, mtime.tv_nsec };
+	/* FNV-1a over the path and its mtime */
+	for(const char *cp = path; *cp; cp++) {
+		hash = (hash ^ (uint8)*cp) * 0x100000001b3ULL;
+	}
+	const uint8 *wp = (const uint8 *)words;
+	for(size_t dex = 0; dex < sizeof(words); dex++) {
+		hash = (hash ^ wp[dex]) * 0x100000001b3ULL;
+	}
+}
+
+static void scanStampAdd(
+	uint64_t &hash,
+	const char *path)
+{
+	struct stat sb;
+	struct timespec mtime = { 0, 0 };		// a missing file hashes as mtime 0
+	MSIoDbg("stat %s in scanStampAdd", path);
+	if(!::stat(path, &sb)) {
+		mtime = sb.st_mtimespec;
+	}
+	scanStampMix(hash, path, mtime);
+}
+
+static void scanStampAddBundleDir(
+	uint64_t &hash,
+	const char *bundleDirPath)
+{
+	scanStampAdd(hash, bundleDirPath);
+	DIR *dir = opendir(bundleDirPath);
+	if (dir == NULL) {
+		return;
+	}
+	struct dirent *dp;
+	char fullPath[MAXPATHLEN];
+	while ((dp = readdir(dir)) != NULL) {
+		if(isBundle(dp)) {
+			snprintf(fullPath, sizeof(fullPath), "%s/%s", bundleDirPath, dp->d_name);
+			scanStampAdd(hash, fullPath);
+		}
+	}
+	closedir(dir);
+}
+
+/* the inputs of an update: for root the system DB is an output instead */
+static uint64_t scanStampInputs(
+	bool isRoot,
+	const char *userBundlePath)		// empty: no user bundles
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	if(!isRoot) {
+		scanStampAdd(hash, MDS_DIRECT_DB_PATH);
+	}
+	scanStampAddBundleDir(hash, MDS_BUNDLE_PATH);
+	if(userBundlePath[0]) {
+		scanStampAddBundleDir(hash, userBundlePath);
+	}
+	return hash;
+}
+
+/* the DB files the update wrote */
+static void scanStampAddDbFiles(
+	uint64_t &hash,
+	const std::string &dbDir)
+{
+	scanStampAdd(hash, (dbDir + "/" MDS_OBJECT_DB_NAME).c_str());
+	scanStampAdd(hash, (dbDir + "/" MDS_DIRECT_DB_NAME).c_str());
+}
+
+/* what the stamp of an update would be if it ran now */
+static uint64_t currentScanFingerprint(
+	bool isRoot,
+	const std::string &dbDir,
+	const char *userBundlePath,
+	const vector<string> &pluginPaths)
+{
+	uint64_t hash = scanStampInputs(isRoot, userBundlePath);
+	for(vector<string>::const_iterator it = pluginPaths.begin(); it != pluginPaths.end(); ++it) {
+		scanStampAdd(hash, it->c_str());
+	}
+	scanStampAddDbFiles(hash, dbDir);
+	return hash;
+}
+
+#define MDS_SCAN_STAMP_MAX_SIZE		(256 * 1024)
+
+/*
+ * Read a stamp written by writeScanStamp(). Only a regular file owned by
+ * ownerUid and writable by nobody else is trusted; anything else just means
+ * a full scan.
+ */
+static bool readScanStamp(
+	const std::string &path,
+	uid_t ownerUid,
+	uint64_t &fingerprint,
+	vector<string> &pluginPaths)	// RETURNED
+{
+	int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat sb;
+	if(fstat(fd, &sb) ||
+	   !S_ISREG(sb.st_mode) ||
+	   (sb.st_uid != ownerUid) ||
+	   (sb.st_mode & (S_IWGRP | S_IWOTH)) ||
+	   (sb.st_size <= 0) || (sb.st_size > MDS_SCAN_STAMP_MAX_SIZE)) {
+		MSDebug("readScanStamp: ignoring untrusted stamp %s", path.c_str());
+		close(fd);
+		return false;
+	}
+	std::string contents((size_t)sb.st_size, '\0');
+	ssize_t rtn = read(fd, &contents[0], contents.size());
+	close(fd);
+	if(rtn != (ssize_t)contents.size()) {
+		return false;
+	}
+
+	/* first line is the fingerprint, then one recorded plugin path per line */
+	const char *buf = contents.c_str();
+	char *end;
+	fingerprint = strtoull(buf, &end, 16);
+	if((end == buf) || (*end != '\n')) {
+		return false;
+	}
+	pluginPaths.clear();
+	size_t pos = end - buf + 1;
+	while(pos < contents.size()) {
+		size_t eol = contents.find('\n', pos);
+		if(eol == std::string::npos) {
+			return false;		// torn write
+		}
+		pluginPaths.push_back(contents.substr(pos, eol - pos));
+		pos = eol + 1;
+	}
+	return true;
+}
+
+/* atomically replace the stamp; failure just means a full scan next time */
+static void writeScanStamp(
+	const std::string &path,
+	uint64_t fingerprint,
+	const vector<string> &pluginPaths,
+	mode_t mode)
+{
+	std::string tmpPath = path + ".tmp";
+	unlink(tmpPath.c_str());
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, mode);
+	if(fd < 0) {
+		MSDebug("writeScanStamp: error %d creating %s", errno, tmpPath.c_str());
+		return;
+	}
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%llx\n", (unsigned long long)fingerprint);
+	std::string contents = buf;
+	for(vector<string>::const_iterator it = pluginPaths.begin(); it != pluginPaths.end(); ++it) {
+		contents += *it + "\n";
+	}
+	bool ok = (write(fd, contents.data(), contents.size()) == (ssize_t)contents.size());
+	close(fd);
+	if(!ok || rename(tmpPath.c_str(), path.c_str())) {
+		MSDebug("writeScanStamp: error %d writing %s", errno, path.c_str());
+		unlink(tmpPath.c_str());
+	}
+}
+
 #define COPY_BUF_SIZE	65536
 
 /* 
@@ -1102,6 +1289,28 @@ void MDSSession::updateDataBases()
 		}
 	}
 
+	/*
+	 * Nothing changed since the last full update? Then the DBs are good as
+	 * they are. This only applies once the directory and both DB files have
+	 * passed the same ownership checks the full update does.
+	 */
+	std::string scanStampPath = userDBFileDir + "/" MDS_SCAN_STAMP_NAME;
+	{
+		struct stat objStat, directStat;
+		uint64_t lastFingerprint;
+		vector<string> lastPluginPaths;
+		if(doFilesExist(userObjDBFilePath.c_str(), userDirectDBFilePath.c_str(), ourUid, false,
+				objStat, directStat) &&
+		   readScanStamp(scanStampPath, ourUid, lastFingerprint, lastPluginPaths) &&
+		   (lastFingerprint == currentScanFingerprint(isRoot, userDBFileDir, userBundlePath,
+				lastPluginPaths))) {
+			MSDebug("MDS inputs unchanged; using DBs at %s", userDBFileDir.c_str());
+			mModule.setDbPath(userDBFileDir.c_str());
+			mModule.lastScanIsNow();
+			return;
+		}
+	}
+
 	/* always release userLockFd no matter what happens */
     LockHelper lh;
 
@@ -1109,6 +1318,8 @@ void MDSSession::updateDataBases()
 		CssmError::throwMeNoLogging(CSSM_ERRCODE_MDS_ERROR);
 	}
 	try {
+		/* snapshot the inputs before anything below looks at them */
+		uint64_t scanStamp = scanStampInputs(isRoot, userBundlePath);
 		if(!isRoot) {
 			try {
 				/* 
@@ -1169,15 +1380,28 @@ void MDSSession::updateDataBases()
 		 * Update per-user DBs from both bundle sources (System bundles, user bundles)
 		 * as appropriate. 
 		 */
-		DbFilesInfo dbFiles(*this, userDBFileDir.c_str());
-		dbFiles.removeOutdatedPlugins();
-		dbFiles.updateSystemDbInfo(NULL, MDS_BUNDLE_PATH);
-		if(userBundlePath[0]) {
-			/* skip for invalid or missing $HOME... */
-			if(checkUserBundles(userBundlePath)) {
-				dbFiles.updateForBundleDir(userBundlePath);
+		vector<string> pluginPaths;
+		{
+			DbFilesInfo dbFiles(*this, userDBFileDir.c_str());
+			dbFiles.removeOutdatedPlugins();
+			dbFiles.updateSystemDbInfo(NULL, MDS_BUNDLE_PATH);
+			if(userBundlePath[0]) {
+				/* skip for invalid or missing $HOME... */
+				if(checkUserBundles(userBundlePath)) {
+					dbFiles.updateForBundleDir(userBundlePath);
+				}
 			}
-		}
+			/* plugins as they were when the update looked at them */
+			const DbFilesInfo::PluginStampVector &plugins = dbFiles.pluginStamps();
+			for(DbFilesInfo::PluginStampVector::const_iterator it = plugins.begin();
+					it != plugins.end(); ++it) {
+				scanStampMix(scanStamp, it->path.c_str(), it->mtime);
+				pluginPaths.push_back(it->path);
+			}
+		}	/* DBs committed and closed */
+		scanStampAddDbFiles(scanStamp, userDBFileDir);
+		writeScanStamp(scanStampPath, scanStamp, pluginPaths,
+			isRoot ? MDS_SYSTEM_DB_MODE : MDS_USER_DB_MODE);
 		mModule.setDbPath(userDBFileDir.c_str());
 	}	/* main block protected by mLockFd */
 	catch(...) {
@@ -1539,6 +1763,10 @@ void MDSSession::DbFilesInfo::checkOutdatedPlugin(
             MSDebug("checkOutdatedPlugin: flagging %s obsolete, but guid length is invalid (%zu)", path.c_str(), guidValue.Length);
         }
 	}
+	else {
+		PluginStamp stamp = { path, sb.st_mtimespec };
+		mPluginStamps.push_back(stamp);
+	}
 }
 
 /*
@@ -1826,12 +2054,19 @@ void MDSSession::DbFilesInfo::updateForBundle(
 		/* Yep, we're done */
 		return;
 	}
+	/* note the bundle's mtime before parsing, in case it changes meanwhile */
+	struct stat sb;
+	PluginStamp stamp = { bundlePath, { 0, 0 } };
+	if(!::stat(bundlePath, &sb)) {
+		stamp.mtime = sb.st_mtimespec;
+	}
 	MDSAttrParser parser(bundlePath,
 		mSession,
 		objDbHand(),
 		directDbHand());
 	try {
 		parser.parseAttrs();
+		mPluginStamps.push_back(stamp);
 	}
 	catch (const CssmError &err) {
 		// a corrupt MDS info file invalidates the entire plugin
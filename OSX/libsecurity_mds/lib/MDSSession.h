@@ -96,6 +96,13 @@ public:
 		CSSM_DB_HANDLE objDbHand();
 		CSSM_DB_HANDLE directDbHand();
 		time_t laterTimestamp()			{ return mLaterTimestamp; }
+		/* plugin paths recorded in the object DB and their mtimes when examined */
+		struct PluginStamp {
+			string path;
+			struct timespec mtime;
+		};
+		typedef vector<PluginStamp> PluginStampVector;
+		const PluginStampVector &pluginStamps()	{ return mPluginStamps; }
 
 		/* public functions used by MDSSession */
 		void updateSystemDbInfo(
@@ -133,6 +140,7 @@ public:
 		CSSM_DB_HANDLE mObjDbHand;
 		CSSM_DB_HANDLE mDirectDbHand;
 		time_t mLaterTimestamp;
+		PluginStampVector mPluginStamps;
 	};	/* DbFilesInfo */
 private:
     class LockHelper
@@ -81,6 +81,12 @@ public:
 	bool compareToExist(
 		const CSSM_DATA	&exist);
 
+	/*
+	 * The one component which appears unhashed in every CertID; usable as
+	 * a lookup key regardless of the hash algorithm a responder chose.
+	 */
+	const CSSM_DATA &subjectSerial() const		{ return mSubjectSerial; }
+
 private:
 	CSSM_DATA mIssuerName;
 	CSSM_DATA mIssuerPubKey;
@@ -46,6 +46,7 @@
 #include <security_asn1/secport.h>
 
 #include <CommonCrypto/CommonDigest.h>
+#include <dispatch/dispatch.h>
 
 #include <Security/SecCmsDigestContext.h>
 
@@ -56,6 +57,16 @@
         MAX(_max_st, U);                   \
     })
 
+/*
+ * Updates at least this long are spread over one thread per digest algorithm
+ * when more than one digest is being computed (e.g. SHA-1 + SHA-256 for
+ * detached installer payloads); below it the dispatch overhead isn't worth it.
+ */
+#define CMS_DIGEST_PARALLEL_MIN (256 * 1024)
+
+/* CommonCrypto takes CC_LONG lengths, so longer buffers are fed in slices */
+#define CMS_DIGEST_MAX_SLICE (1U << 30)
+
 struct SecCmsDigestContextStr {
     PLArenaPool* poolp;
     Boolean saw_contents;
@@ -163,47 +174,88 @@ SecCmsDigestContextRef SecCmsDigestContextStartSingle(SECAlgorithmID* digestalg)
     return SecCmsDigestContextStartMultiple(digestalgs);
 }
 
+/*
+ * Feed data into a single digest object, in CC_LONG-sized slices.
+ */
+static void SecCmsDigestUpdateOne(SECAlgorithmID* digestalg, void* digobj, const unsigned char* data, size_t len)
+{
+    SECOidTag hash_alg = SECOID_GetAlgorithmTag(digestalg);
+
+    while (len > 0) {
+        CC_LONG slice = (CC_LONG)MIN(len, (size_t)CMS_DIGEST_MAX_SLICE);
+        switch (hash_alg) {
+            case SEC_OID_SHA1:
+                CC_SHA1_Update((CC_SHA1_CTX*)digobj, data, slice);
+                break;
+            case SEC_OID_MD5:
+                CC_MD5_Update((CC_MD5_CTX*)digobj, data, slice);
+                break;
+            case SEC_OID_SHA224:
+                CC_SHA224_Update((CC_SHA256_CTX*)digobj, data, slice);
+                break;
+            case SEC_OID_SHA256:
+                CC_SHA256_Update((CC_SHA256_CTX*)digobj, data, slice);
+                break;
+            case SEC_OID_SHA384:
+                CC_SHA384_Update((CC_SHA512_CTX*)digobj, data, slice);
+                break;
+            case SEC_OID_SHA512:
+                CC_SHA512_Update((CC_SHA512_CTX*)digobj, data, slice);
+                break;
+            default:
+                return;
+        }
+        data += slice;
+        len -= slice;
+    }
+}
+
+struct SecCmsDigestUpdateArgs {
+    SecCmsDigestContextRef cmsdigcx;
+    const unsigned char* data;
+    size_t len;
+};
+
+static void SecCmsDigestUpdateApplier(void* context, size_t i)
+{
+    struct SecCmsDigestUpdateArgs* args = (struct SecCmsDigestUpdateArgs*)context;
+
+    if (args->cmsdigcx->digobjs[i]) {
+        SecCmsDigestUpdateOne(args->cmsdigcx->digestalgs[i], args->cmsdigcx->digobjs[i], args->data, args->len);
+    }
+}
+
 /*
  * SecCmsDigestContextUpdate - feed more data into the digest machine
+ *
+ * Large buffers (a whole detached payload, typically mapped straight from
+ * disk) are hashed by every requested algorithm concurrently, reading the
+ * caller's buffer in place.
  */
 void SecCmsDigestContextUpdate(SecCmsDigestContextRef cmsdigcx, const unsigned char* data, size_t len)
 {
-    /* rdar://problem/20642513. There is really no good way to return an error here, so let's just
-       exit without having "seen" any contents. This should cause hash comparisons to fail during
-       validation.
-     */
-    if (len > UINT32_MAX) {
-        secerror("SecCmsDigestContextUpdate: data size too big (%zu), skipping", len);
+    int i;
+    int active = 0;
+
+    cmsdigcx->saw_contents = PR_TRUE;
+    for (i = 0; i < cmsdigcx->digcnt; i++) {
+        if (cmsdigcx->digobjs[i]) {
+            active++;
+        }
+    }
+
+    if (active > 1 && len >= CMS_DIGEST_PARALLEL_MIN) {
+        struct SecCmsDigestUpdateArgs args = {cmsdigcx, data, len};
+        dispatch_apply_f((size_t)cmsdigcx->digcnt,
+                         dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+                         &args,
+                         SecCmsDigestUpdateApplier);
         return;
     }
 
-    int i;
-    cmsdigcx->saw_contents = PR_TRUE;
     for (i = 0; i < cmsdigcx->digcnt; i++) {
         if (cmsdigcx->digobjs[i]) {
-            assert(len <= UINT32_MAX); /* Debug check. Correct as long as CC_LONG is uint32_t */
-            switch (SECOID_GetAlgorithmTag(cmsdigcx->digestalgs[i])) {
-                case SEC_OID_SHA1:
-                    CC_SHA1_Update((CC_SHA1_CTX*)cmsdigcx->digobjs[i], data, (CC_LONG)len);
-                    break;
-                case SEC_OID_MD5:
-                    CC_MD5_Update((CC_MD5_CTX*)cmsdigcx->digobjs[i], data, (CC_LONG)len);
-                    break;
-                case SEC_OID_SHA224:
-                    CC_SHA224_Update((CC_SHA256_CTX*)cmsdigcx->digobjs[i], data, (CC_LONG)len);
-                    break;
-                case SEC_OID_SHA256:
-                    CC_SHA256_Update((CC_SHA256_CTX*)cmsdigcx->digobjs[i], data, (CC_LONG)len);
-                    break;
-                case SEC_OID_SHA384:
-                    CC_SHA384_Update((CC_SHA512_CTX*)cmsdigcx->digobjs[i], data, (CC_LONG)len);
-                    break;
-                case SEC_OID_SHA512:
-                    CC_SHA512_Update((CC_SHA512_CTX*)cmsdigcx->digobjs[i], data, (CC_LONG)len);
-                    break;
-                default:
-                    break;
-            }
+            SecCmsDigestUpdateOne(cmsdigcx->digestalgs[i], cmsdigcx->digobjs[i], data, len);
         }
     }
 }
@@ -1,6 +1,7 @@
 #include "SecTransformReadTransform.h"
 #include "SecCustomTransform.h"
 #include "Utilities.h"
+#include <errno.h>
 
 static CFStringRef kStreamTransformName = CFSTR("SecReadStreamTransform");
 static CFStringRef kStreamMaxSize = CFSTR("MAX_READSIZE");
@@ -18,7 +19,7 @@ static SecTransformInstanceBlock StreamTransformImplementation(CFStringRef name,
 		}
 		
 		// define the storage for our block
-		__block CFIndex blockSize = 4096;  // make a default block size
+		__block CFIndex blockSize = 65536;  // make a default block size; large enough to amortize the per-chunk hop downstream
 		
 		// it's not necessary to set the input stream size
 		SecTransformCustomSetAttribute(ref, kStreamMaxSize, kSecTransformMetaAttributeRequired, kCFBooleanFalse);
@@ -81,11 +82,22 @@ static SecTransformInstanceBlock StreamTransformImplementation(CFStringRef name,
 			
 			CFIndex bytesRead;
 			
-			bytesRead = CFReadStreamRead(input, buffer, blockSize);
+			bytesRead = buffer ? CFReadStreamRead(input, buffer, blockSize) : -1;
 			while (bytesRead > 0)
 			{
-				// make data from what was read
-				CFDataRef value = CFDataCreate(NULL, buffer, bytesRead);
+				// make data from what was read.  Mostly-full reads hand the buffer itself
+				// to the CFData and we read the next chunk into a fresh one; short reads
+				// are copied so downstream doesn't hold on to a mostly empty block.
+				CFDataRef value;
+				if (bytesRead >= blockSize / 2)
+				{
+					value = CFDataCreateWithBytesNoCopy(NULL, buffer, bytesRead, kCFAllocatorMalloc);
+					buffer = (u_int8_t*) malloc(blockSize);
+				}
+				else
+				{
+					value = CFDataCreate(NULL, buffer, bytesRead);
+				}
 				
 				// send it down the chain
 				SecTransformCustomSetAttribute(ref, kSecTransformOutputAttributeName, kSecTransformMetaAttributeValue, value);
@@ -93,7 +105,16 @@ static SecTransformInstanceBlock StreamTransformImplementation(CFStringRef name,
 				// cleanup
 				CFReleaseNull(value);
 				
-				bytesRead = CFReadStreamRead(input, buffer, blockSize);
+				bytesRead = buffer ? CFReadStreamRead(input, buffer, blockSize) : -1;
+			}
+			
+			if (buffer == NULL)
+			{
+				// out of memory for the next chunk; don't let that pass for end of stream
+				CFErrorRef error = CreateSecTransformErrorRef(kSecTransformErrorNotInitializedCorrectly, CFSTR("Could not allocate a read buffer (errno %d)."), ENOMEM);
+				SecTransformCustomSetAttribute(ref, kSecTransformOutputAttributeName, kSecTransformMetaAttributeValue, error);
+				CFReleaseNull(error);
+				return (CFTypeRef) NULL;
 			}
 			
 			free(buffer);
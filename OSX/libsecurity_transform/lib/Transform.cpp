@@ -1022,7 +1022,12 @@ CFErrorRef Transform::SetAttribute(CFTypeRef key, CFTypeRef value)
 	
 	// when the transform is active, set attributes asynchronously.  Otherwise, we are doing
 	// initialization and must wait for the operation to complete.
-	if (mIsActive)
+	//
+	// A value flowing across a connection from another transform's queue is waited on below
+	// anyway, so deliver it with dispatch_sync: the receiver's Do then runs on the sender's
+	// thread (still serialized by ta->q) and a chain of transforms costs no thread hops.
+	Transform *sender = static_cast<Transform *>(dispatch_get_specific(&dispatchQueueToTransformKey));
+	if (mIsActive && (sender == NULL || sender == this))
 	{
 		dispatch_async(ta->q, set);
 	}
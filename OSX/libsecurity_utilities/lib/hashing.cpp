@@ -26,6 +26,8 @@
 //
 #include "hashing.h"
 #include "unix++.h"
+#include <dispatch/dispatch.h>
+#include <algorithm>
 
 
 namespace Security {
@@ -62,5 +64,45 @@ void CCHashInstance::finish(unsigned char *digest)
 }
 
 
+//
+// Page hashing. Pages are handed out to dispatch_apply() in groups so that the
+// per-iteration overhead stays small next to the hashing itself.
+//
+static const size_t pagesPerWorkItem = 16;
+
+void hashPages(DynamicHash *(^makeHash)(), size_t digestLength,
+	const void *data, size_t length, size_t pageSize, size_t pageCount, Hashing::Byte *digests)
+{
+	const Hashing::Byte *bytes = (const Hashing::Byte *)data;
+	void (^hashRange)(size_t, size_t) = ^(size_t first, size_t end) {
+		for (size_t page = first; page < end; page++) {
+			size_t offset = std::min(page * pageSize, length);
+			RefPointer<DynamicHash> hasher = makeHash();
+			hasher->update(bytes + offset, std::min(pageSize, length - offset));
+			hasher->finish(digests + page * digestLength);
+		}
+	};
+
+	size_t items = (pageCount + pagesPerWorkItem - 1) / pagesPerWorkItem;
+	if (items <= 1) {
+		hashRange(0, pageCount);
+		return;
+	}
+
+	__block bool failed = false;
+	dispatch_apply(items, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t item) {
+		try {
+			hashRange(item * pagesPerWorkItem, std::min(pageCount, (item + 1) * pagesPerWorkItem));
+		} catch (...) {
+			failed = true;
+		}
+	});
+
+	// exceptions can't leave dispatch_apply(); redo the work here to let them reach the caller
+	if (failed)
+		hashRange(0, pageCount);
+}
+
+
 
 }	// Security
@@ -112,6 +112,16 @@ public:
 };
 
 
+//
+// Hash consecutive pageSize pages of a memory buffer independently, page n into
+// digests + n * digestLength, spreading the pages over the available cores.
+// makeHash is called for a fresh hasher for each page. Pages that lie (partly)
+// past length hash only the bytes that are there.
+//
+void hashPages(DynamicHash *(^makeHash)(), size_t digestLength,
+	const void *data, size_t length, size_t pageSize, size_t pageCount, Hashing::Byte *digests);
+
+
 //
 // Make a DynamicHash from a CommonCrypto hash algorithm identifier
 //
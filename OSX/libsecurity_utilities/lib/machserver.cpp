@@ -33,6 +33,7 @@
 #include "mach_notifyServer.h"
 #include <security_utilities/debugging.h>
 #include <malloc/malloc.h>
+#include <algorithm>
 
 #if defined(USECFCURRENTTIME)
 # include <CoreFoundation/CFDate.h>
@@ -73,6 +74,10 @@ void MachServer::setup(const char *name)
 	workerTimeout = 60 * 2;	// 2 minutes default timeout
 	maxWorkerCount = 100;	// make sure we don't go too wide
 	useFloatingThread = false; // tight thread management
+	useAdaptiveThreads = false;
+	mQueueDelayTarget = 0.002; // 2ms
+	queueDelay = 0;
+	saturated = false;
     
     mPortSet += mServerPort;
 }
@@ -122,7 +127,7 @@ void MachServer::run(mach_msg_size_t maxSize, mach_msg_options_t options)
 	// establish the thread pool state
 	// (don't need managerLock since we're the only thread as of yet)
 	idleCount = workerCount = 1;
-	nextCheckTime = Time::now() + workerTimeout;
+	nextCheckTime = Time::now() + reapInterval();
 	leastIdleWorkers = 1;
 	highestWorkerCount = 1;
 	
@@ -179,7 +184,7 @@ void MachServer::runServerThread(bool doTimeout)
 					if (rightNow >= nextCheckTime) {	// reaping period complete; process
 						UInt32 idlers = leastIdleWorkers;
                         secinfo("machserver", "reaping workers: %d %d", (uint32_t) workerCount, (uint32_t) idlers);
-						nextCheckTime = rightNow + workerTimeout;
+						nextCheckTime = rightNow + reapInterval();
 						leastIdleWorkers = INT_MAX;
 						if (idlers > 1)					// multiple idle threads throughout measuring interval...
 							break;						// ... so release this thread now
@@ -241,6 +246,7 @@ void MachServer::runServerThread(bool doTimeout)
 				// normal request message
 				StLock<MachServer, &MachServer::busy, &MachServer::idle> _(*this);
                 secinfo("machserver", "begin request: %d, %d", bufRequest.localPort().port(), bufRequest.msgId());
+				Time::Absolute started = Time::now();
 				
 				// try subsidiary handlers first
 				bool handled = false;
@@ -255,6 +261,7 @@ void MachServer::runServerThread(bool doTimeout)
                     handle(bufRequest, bufReply);
                 }
 
+				mLatency.record(bufRequest.msgId(), Time::now() - started);
                 secinfo("machserver", "end request");
 			}
 
@@ -404,26 +411,50 @@ void MachServer::releaseDeferredAllocations()
 //
 void MachServer::longTermActivity()
 {
-	if (!useFloatingThread) {
+	if (!floating()) {
 		StLock<Mutex> _(managerLock);
 		ensureReadyThread();
 	}
 }
 
+//
+// While no worker is idle, newly arriving requests queue in the kernel. We
+// time each such stretch and keep a moving average of it as our measure of
+// queueing delay. In adaptive mode, a delay above target makes us start a
+// spare thread as soon as the pool saturates (as floatingThread would) and
+// keeps idle workers around for the full workerTimeout; below target, excess
+// workers are reaped sooner. Adaptive mode replaces the floating thread, so a
+// server with both set grows only on measured delay (or longTermActivity).
+//
 void MachServer::busy()
 {
 	StLock<Mutex> _(managerLock);
 	idleCount--;
-	if (useFloatingThread)
+	if (idleCount == 0 && !saturated) {
+		saturated = true;
+		saturatedSince = Time::now();
+	}
+	if (floating() || (useAdaptiveThreads && queueDelay > mQueueDelayTarget))
 		ensureReadyThread();
 }
 
 void MachServer::idle()
 {
 	StLock<Mutex> _(managerLock);
+	if (saturated) {
+		saturated = false;
+		queueDelay = queueDelay * 0.875 + (Time::now() - saturatedSince) * 0.125;
+	}
 	idleCount++;
 }
 
+Time::Interval MachServer::reapInterval() const
+{
+	if (useAdaptiveThreads && queueDelay <= mQueueDelayTarget)
+		return workerTimeout / 4;
+	return workerTimeout;
+}
+
 
 void MachServer::ensureReadyThread()
 {
@@ -625,6 +656,105 @@ void MachServer::notifyNoSenders(Port, mach_port_mscount_t) { }
 void MachServer::eventDone() { }
 
 
+//
+// Service time histograms
+//
+LatencyHistograms::LatencyHistograms()
+{
+	for (unsigned n = 0; n < slotCount; n++) {
+		Slot &slot = mSlots[n];
+		slot.key = 0;
+		slot.count = 0;
+		slot.maxMicros = 0;
+		for (unsigned b = 0; b < bucketCount; b++)
+			slot.buckets[b] = 0;
+	}
+}
+
+void LatencyHistograms::record(mach_msg_id_t msgId, Time::Interval serviceTime)
+{
+	uint64_t key = uint64_t(uint32_t(msgId)) + 1;
+	unsigned start = uint32_t(msgId) % slotCount;
+	for (unsigned probe = 0; probe < slotCount; probe++) {
+		Slot &slot = mSlots[(start + probe) % slotCount];
+		uint64_t current = slot.key.load(std::memory_order_relaxed);
+		if (current == 0) {
+			uint64_t expected = 0;
+			if (slot.key.compare_exchange_strong(expected, key, std::memory_order_relaxed))
+				current = key;
+			else
+				current = expected;	// somebody else claimed it first
+		}
+		if (current != key)
+			continue;
+
+		double usec = std::max(serviceTime.uSeconds(), 0.0);
+		uint64_t micros = uint64_t(usec);
+		unsigned bucket = 0;
+		while (bucket < bucketCount - 1 && (uint64_t(1) << bucket) <= micros)
+			bucket++;
+		slot.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		slot.count.fetch_add(1, std::memory_order_relaxed);
+		uint64_t seen = slot.maxMicros.load(std::memory_order_relaxed);
+		while (micros > seen && !slot.maxMicros.compare_exchange_weak(seen, micros, std::memory_order_relaxed))
+			;
+		return;
+	}
+	// table full; this id goes unrecorded
+}
+
+std::vector<LatencyHistograms::Summary> LatencyHistograms::summarize() const
+{
+	std::vector<Summary> result;
+	for (unsigned n = 0; n < slotCount; n++) {
+		const Slot &slot = mSlots[n];
+		uint64_t key = slot.key.load(std::memory_order_relaxed);
+		if (key == 0)
+			continue;
+
+		uint64_t counts[bucketCount];
+		uint64_t total = 0;
+		for (unsigned b = 0; b < bucketCount; b++)
+			total += counts[b] = slot.buckets[b].load(std::memory_order_relaxed);
+		if (total == 0)
+			continue;
+
+		Summary summary;
+		summary.msgId = mach_msg_id_t(key - 1);
+		summary.count = total;
+		summary.max = Time::Interval(slot.maxMicros.load(std::memory_order_relaxed) / 1E6);
+		uint64_t seen = 0;
+		bool haveP50 = false;
+		for (unsigned b = 0; b < bucketCount; b++) {
+			seen += counts[b];
+			Time::Interval upper = Time::Interval(double(uint64_t(1) << b) / 1E6);
+			if (!haveP50 && seen * 2 >= total) {
+				summary.p50 = upper;
+				haveP50 = true;
+			}
+			if (seen * 100 >= total * 99) {
+				summary.p99 = upper;
+				break;
+			}
+		}
+		result.push_back(summary);
+	}
+	return result;
+}
+
+void MachServer::logLatency() const
+{
+	std::vector<LatencyHistograms::Summary> summaries = mLatency.summarize();
+	secnotice("machserver", "latency: %u workers, queue delay %.3fms",
+		(unsigned)workerCount, queueDelay.mSeconds());
+	for (std::vector<LatencyHistograms::Summary>::const_iterator it = summaries.begin();
+			it != summaries.end(); it++)
+		secnotice("machserver", "latency: msg %d count %llu p50 %.3fms p99 %.3fms max %.3fms",
+			it->msgId, (unsigned long long)it->count,
+			it->p50.mSeconds(), it->p99.mSeconds(), it->max.mSeconds());
+}
+
+
 } // end namespace MachPlusPlus
 
 } // end namespace Security
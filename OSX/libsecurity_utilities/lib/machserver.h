@@ -35,6 +35,8 @@
 #include <security_utilities/alloc.h>
 #include <security_utilities/tqueue.h>
 #include <set>
+#include <vector>
+#include <atomic>
 
 namespace Security {
 namespace MachPlusPlus {
@@ -49,6 +51,42 @@ extern "C" {
 };
 
 
+//
+// Per-message-id service time histograms.
+// Recording is lock-free: message ids claim a slot in a fixed open-addressed
+// table with a compare-and-swap, and samples are counted into log2(microsecond)
+// buckets with relaxed atomic increments. Ids beyond the table's capacity
+// are simply not recorded.
+//
+class LatencyHistograms {
+public:
+	static const unsigned bucketCount = 32;		// bucket n holds [2^(n-1), 2^n) usec
+	static const unsigned slotCount = 128;		// distinct message ids tracked
+
+	struct Summary {
+		mach_msg_id_t msgId;
+		uint64_t count;
+		Time::Interval p50;		// percentiles are bucket upper bounds
+		Time::Interval p99;
+		Time::Interval max;
+	};
+
+	LatencyHistograms();
+
+	void record(mach_msg_id_t msgId, Time::Interval serviceTime);
+	std::vector<Summary> summarize() const;
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> key;		// msgId + 1; 0 = unused
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> maxMicros;
+		std::atomic<uint64_t> buckets[bucketCount];
+	};
+	Slot mSlots[slotCount];
+};
+
+
 //
 // Mach server object
 //
@@ -89,6 +127,17 @@ public:
 	bool floatingThread() const		{ return useFloatingThread; }
 	void floatingThread(bool t)		{ useFloatingThread = t; }
 	
+	// size the worker pool from observed queueing delay (see busy/idle);
+	// takes precedence over floatingThread when both are set
+	bool adaptiveThreads() const	{ return useAdaptiveThreads; }
+	void adaptiveThreads(bool a)	{ useAdaptiveThreads = a; }
+	Time::Interval queueDelayTarget() const { return mQueueDelayTarget; }
+	void queueDelayTarget(Time::Interval t) { mQueueDelayTarget = t; }
+	
+	// per-message-id service times of requests handled so far
+	const LatencyHistograms &latency() const { return mLatency; }
+	void logLatency() const;
+	
 	Port primaryServicePort() const	{ return mServerPort; }
 	
 	// the currently active server in this thread (there can only be one)
@@ -224,6 +273,16 @@ protected:
 	UInt32 leastIdleWorkers; // max(idleCount) since last checkpoint
 	ScheduleQueue<Time::Absolute> timers;
 
+	bool useAdaptiveThreads; // grow/shrink the pool from queueDelay
+	Time::Interval mQueueDelayTarget; // queueing delay we try to stay under
+	Time::Interval queueDelay; // moving average of time spent with no idle worker
+	bool saturated;			// idleCount reached zero at saturatedSince
+	Time::Absolute saturatedSince;
+	LatencyHistograms mLatency;
+
+	Time::Interval reapInterval() const;
+	bool floating() const { return useFloatingThread && !useAdaptiveThreads; }
+
 	void addThread(Thread *thread); // add thread to worker pool
 	void removeThread(Thread *thread); // remove thread from worker pool
     void cleanupWorkers();
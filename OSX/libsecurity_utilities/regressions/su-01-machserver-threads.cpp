@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include "utilities_regressions.h"
+#include <security_utilities/machserver.h>
+#include <unistd.h>
+
+using namespace Security;
+using namespace Security::MachPlusPlus;
+
+/* Test MachServer's adaptive pool sizing: the pool grows only while measured
+   queueing delay is above target, even when floatingThread is also set (as
+   securityd does). */
+
+/*
+ * A one-worker server that never runs its loop. maxThreads is pinned at the
+ * worker count, so every attempt to start a spare thread lands in
+ * threadLimitReached, where we count it instead.
+ */
+class TestServer : public MachServer {
+public:
+    TestServer() : growth(0)
+    {
+        workerCount = idleCount = 1;
+        maxThreads(1);
+        queueDelayTarget(0.002);
+    }
+
+    unsigned growth;
+
+    void threadLimitReached(UInt32) { growth++; }
+    boolean_t handle(mach_msg_header_t *, mach_msg_header_t *) { return false; }
+
+    /* one request that keeps the only worker busy for `hold` */
+    void request(useconds_t hold)
+    {
+        busy();
+        if (hold)
+            usleep(hold);
+        idle();
+    }
+
+    Time::Interval delay() const { return queueDelay; }
+    Time::Interval reap() const { return reapInterval(); }
+};
+
+static void tests(void)
+{
+    TestServer server;
+    server.floatingThread(true);
+    server.adaptiveThreads(true);
+
+    /* no delay measured yet: saturating the pool must not grow it */
+    server.request(0);
+    is(server.growth, 0u, "no growth without queueing delay");
+    ok(server.reap() == server.timeout() / 4, "idle workers reaped early");
+
+    /* long saturated stretches push the moving average over target */
+    for (unsigned n = 0; n < 8 && server.delay() <= server.queueDelayTarget(); n++)
+        server.request(20000);
+    ok(server.delay() > server.queueDelayTarget(), "queueing delay above target");
+    unsigned before = server.growth;
+    server.request(0);
+    is(server.growth, before + 1, "saturation grows the pool over target");
+    ok(server.reap() == server.timeout(), "idle workers kept for the full timeout");
+
+    /* short stretches decay the average back under target; growth stops */
+    for (unsigned n = 0; n < 200 && server.delay() > server.queueDelayTarget(); n++)
+        server.request(0);
+    ok(server.delay() <= server.queueDelayTarget(), "queueing delay back under target");
+    before = server.growth;
+    server.request(0);
+    is(server.growth, before, "no growth once under target");
+
+    /* a handler that expects to block still gets a spare thread */
+    server.longTermActivity();
+    is(server.growth, before + 1, "longTermActivity grows the pool");
+
+    /* without adaptive mode, the floating thread behaves as before */
+    TestServer floating;
+    floating.floatingThread(true);
+    floating.request(0);
+    is(floating.growth, 1u, "floating thread grows on saturation");
+    floating.longTermActivity();
+    is(floating.growth, 1u, "longTermActivity is a no-op with a floating thread");
+}
+
+int su_01_machserver_threads(int argc, char *const *argv) {
+    plan_tests(10);
+
+    tests();
+
+    return 0;
+}
@@ -61,6 +61,19 @@ bool_t sec_xdr_bytes(XDR *xdrs, uint8_t **cpp, u_int *sizep, u_int maxsize)
     case XDR_DECODE:
         if (nodesize == 0)
             return (TRUE);
+        if (!sp && nodesize >= SEC_XDR_BORROW_MIN && sec_xdr_arena_borrows(xdrs)) {
+            /* hand out the bytes where they sit in the stream (padding included) */
+            u_int padded = nodesize + ((BYTES_PER_XDR_UNIT - (nodesize % BYTES_PER_XDR_UNIT)) % BYTES_PER_XDR_UNIT);
+            if (padded >= nodesize) {
+                uint8_t *inplace = (uint8_t *)XDR_INLINE(xdrs, padded);
+                if (inplace) {
+                    if (!sizeof_alloc && cpp != NULL)
+                        *cpp = inplace;
+                    return (TRUE);
+                }
+            }
+            /* unaligned stream or short buffer: fall back to copying */
+        }
         if (!sp) {
             if (!sec_mem_alloc(xdrs, nodesize, &sp))
                 return (FALSE);
@@ -148,7 +161,7 @@ void sec_mem_free(XDR *xdr, void *ptr, u_int bsize)
     return free(ptr);
 }
 
-static const sec_xdr_arena_allocator_t size_alloc = { xdr_size_magic, 0, 0, 0 };
+static const sec_xdr_arena_allocator_t size_alloc = { xdr_size_magic, 0, 0, 0, FALSE };
 void sec_xdr_arena_init_size_alloc(sec_xdr_arena_allocator_t *arena, XDR *xdr)
 {
     memcpy(arena, &size_alloc, sizeof(size_alloc));
@@ -167,6 +180,7 @@ bool_t sec_xdr_arena_init(sec_xdr_arena_allocator_t *arena, XDR *xdr,
     arena->offset = data;
     arena->data = data;
     arena->end = data + in_length;
+    arena->borrow = FALSE;
     xdr->x_public = (void*)arena;
     return TRUE;
 }
@@ -198,6 +212,12 @@ sec_xdr_arena_allocator_t *sec_xdr_arena_allocator(XDR *xdr)
     return NULL;
 }
 
+bool_t sec_xdr_arena_borrows(XDR *xdr)
+{
+    sec_xdr_arena_allocator_t *allocator = sec_xdr_arena_allocator(xdr);
+    return (allocator && allocator->borrow);
+}
+
 bool_t sec_xdr_arena_size_allocator(XDR *xdr)
 {
     sec_xdr_arena_allocator_t *allocator = xdr ? (sec_xdr_arena_allocator_t *)xdr->x_public : NULL;
@@ -213,13 +233,27 @@ bool_t copyin(void *data, xdrproc_t proc, void** copy, u_int *size)
     if (!copy)
         return (FALSE);
 
+    XDR xdr;
+
+    // Most transitions carry small structures; try encoding straight into a
+    // first-guess buffer and only take the separate sizing pass if it overflows.
+    uint8_t *xdr_data = malloc(SEC_XDR_COPYIN_GUESS);
+    if (xdr_data) {
+        sec_xdrmem_create(&xdr, (char *)xdr_data, SEC_XDR_COPYIN_GUESS, XDR_ENCODE);
+        if (proc(&xdr, data, 0)) {
+            *copy = xdr_data;
+            if (size) *size = xdr_getpos(&xdr);
+            return (TRUE);
+        }
+        free(xdr_data);
+    }
+
     // xdr_sizeof is illbehaved
     u_int length = sec_xdr_sizeof_in(proc, data);
-    uint8_t *xdr_data = malloc(length);
+    xdr_data = malloc(length);
     if (!xdr_data)
         return (FALSE);
 
-    XDR xdr;
     sec_xdrmem_create(&xdr, (char *)xdr_data, length, XDR_ENCODE);
 
     // cast to void* - function can go both ways (xdr->x_op) 
@@ -240,7 +274,7 @@ bool_t copyin(void *data, xdrproc_t proc, void** copy, u_int *size)
 // If you pass in length pointing to a non-zero value, data will be assumed
 // to have pre-allocated space for use by copyout in that amount.  
 // If *data is not NULL it will be assumed to be allocated already.  
-bool_t copyout(const void *copy, u_int size, xdrproc_t proc, void **data, u_int *length)
+static bool_t copyout_internal(const void *copy, u_int size, xdrproc_t proc, void **data, u_int *length, bool_t borrow)
 {
 
     if (!data || (size > ~(u_int)0))
@@ -249,7 +283,7 @@ bool_t copyout(const void *copy, u_int size, xdrproc_t proc, void **data, u_int
     XDR xdr;
     sec_xdrmem_create(&xdr, (void *)copy, size, XDR_DECODE);
 
-    u_int length_required = sec_xdr_sizeof_out(copy, size, proc, data);
+    u_int length_required = sec_xdr_sizeof_out_borrowed(copy, size, proc, data, borrow);
     u_int length_out = length ? *length : 0;
 
     if (length_out && (length_required > length_out))
@@ -260,6 +294,7 @@ bool_t copyout(const void *copy, u_int size, xdrproc_t proc, void **data, u_int
     // set up arena with memory passed in (length_out > 0) or ask to allocate
     if (!sec_xdr_arena_init(&arena, &xdr, length_out ? length_out : length_required, length_out ? *data : NULL))
         return (FALSE);
+    arena.borrow = borrow;
 
     if (proc(&xdr, data, 0))
     {
@@ -274,6 +309,18 @@ bool_t copyout(const void *copy, u_int size, xdrproc_t proc, void **data, u_int
     return (FALSE);
 }
 
+bool_t copyout(const void *copy, u_int size, xdrproc_t proc, void **data, u_int *length)
+{
+    return copyout_internal(copy, size, proc, data, length, FALSE);
+}
+
+// Same as copyout, but large byte runs are left in copy (see SEC_XDR_BORROW_MIN).
+// Only for callers that keep copy alive for as long as they use data.
+bool_t copyout_borrowed(const void *copy, u_int size, xdrproc_t proc, void **data, u_int *length)
+{
+    return copyout_internal(copy, size, proc, data, length, TRUE);
+}
+
 // unmarshall xdr data and return pointer to individual allocations containing data
 // only use *_PTR for xdrproc_ts and pointers for data
 bool_t copyout_chunked(const void *copy, u_int size, xdrproc_t proc, void **data)
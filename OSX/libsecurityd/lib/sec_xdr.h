@@ -45,8 +45,14 @@ typedef struct sec_xdr_arena_allocator {
     uint8_t *offset;
     uint8_t *data;
     uint8_t *end;
+    bool_t borrow;      /* decode large byte runs in place (see copyout_borrowed) */
 } sec_xdr_arena_allocator_t;
 
+/* byte runs at least this long are borrowed from the stream rather than copied */
+#define SEC_XDR_BORROW_MIN 1024
+/* first-guess buffer size for single-pass copyin */
+#define SEC_XDR_COPYIN_GUESS 1024
+
 #define xdr_arena_magic 0xAEA1
 #define xdr_size_magic 0xDEAD
 
@@ -57,13 +63,18 @@ void sec_xdr_arena_free(sec_xdr_arena_allocator_t *alloc, void *ptr, size_t bsiz
 void *sec_xdr_arena_data(sec_xdr_arena_allocator_t *alloc);
 sec_xdr_arena_allocator_t *sec_xdr_arena_allocator(XDR *xdr);
 bool_t sec_xdr_arena_size_allocator(XDR *xdr);
+bool_t sec_xdr_arena_borrows(XDR *xdr);
 
 bool_t copyin(void * data, xdrproc_t proc, void ** copy, u_int * size);
 bool_t copyout(const void * copy, u_int size, xdrproc_t proc, void ** data, u_int *length);
 bool_t copyout_chunked(const void * copy, u_int size, xdrproc_t proc, void ** data);
+/* Like copyout, but CSSM_DATA-style byte runs of SEC_XDR_BORROW_MIN or more
+   point into copy instead of being duplicated, so copy must outlive data. */
+bool_t copyout_borrowed(const void * copy, u_int size, xdrproc_t proc, void ** data, u_int *length);
 
 u_int sec_xdr_sizeof_in(xdrproc_t func, void * data);
 u_int sec_xdr_sizeof_out(const void * copy, u_int size, xdrproc_t func, void ** data);
+u_int sec_xdr_sizeof_out_borrowed(const void * copy, u_int size, xdrproc_t func, void ** data, bool_t borrow);
 
 __END_DECLS
 
@@ -185,6 +185,12 @@ sec_xdr_sizeof_in(xdrproc_t func, void *data)
 
 u_int
 sec_xdr_sizeof_out(const void *copy, u_int size, xdrproc_t func, void **data)
+{
+    return sec_xdr_sizeof_out_borrowed(copy, size, func, data, FALSE);
+}
+
+u_int
+sec_xdr_sizeof_out_borrowed(const void *copy, u_int size, xdrproc_t func, void **data, bool_t borrow)
 {
     XDR x;
     bool_t stat;
@@ -193,6 +199,7 @@ sec_xdr_sizeof_out(const void *copy, u_int size, xdrproc_t func, void **data)
 
     sec_xdr_arena_allocator_t size_alloc;
     sec_xdr_arena_init_size_alloc(&size_alloc, &x);
+    size_alloc.borrow = borrow;
     stat = func(&x, data, 0);
     if (size_alloc.data)
         free(size_alloc.data);
@@ -20,6 +20,7 @@ ONE_TEST(si_12_item_stress)
 ONE_TEST(si_14_dateparse)
 DISABLED_ONE_TEST(si_15_delete_access_group)
 ONE_TEST(si_17_item_system_bluetooth)
+ONE_TEST(si_19_certificate_intern)
 DISABLED_ONE_TEST(si_30_keychain_upgrade) //obsolete, needs updating
 DISABLED_ONE_TEST(si_31_keychain_bad)
 DISABLED_ONE_TEST(si_31_keychain_unreadable)
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <Security/SecCertificate.h>
+#include <Security/SecCertificatePriv.h>
+#include <Security/SecCertificateInternal.h>
+#include <utilities/SecCFWrappers.h>
+
+#include "Security_regressions.h"
+
+/* Test certificate interning: identical DER yields one shared instance and
+   counts a hit, while SecCertificateCreateWithKeychainItem always builds a
+   private instance. */
+
+static const uint8_t _c0[] = {
+    0x30, 0x82, 0x04, 0xbb, 0x30, 0x82, 0x03, 0xa3,
+    0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x01, 0x02,
+    0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+    0xf7, 0x0d, 0x01, 0x01, 0x05, 0x05, 0x00, 0x30,
+    0x62, 0x31, 0x0b, 0x30, 0x09, 0x06, 0x03, 0x55,
+    0x04, 0x06, 0x13, 0x02, 0x55, 0x53, 0x31, 0x13,
+    0x30, 0x11, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x13,
+    0x0a, 0x41, 0x70, 0x70, 0x6c, 0x65, 0x20, 0x49,
+    0x6e, 0x63, 0x2e, 0x31, 0x26, 0x30, 0x24, 0x06,
+    0x03, 0x55, 0x04, 0x0b, 0x13, 0x1d, 0x41, 0x70,
+    0x70, 0x6c, 0x65, 0x20, 0x43, 0x65, 0x72, 0x74,
+    0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f,
+    0x6e, 0x20, 0x41, 0x75, 0x74, 0x68, 0x6f, 0x72,
+    0x69, 0x74, 0x79, 0x31, 0x16, 0x30, 0x14, 0x06,
+    0x03, 0x55, 0x04, 0x03, 0x13, 0x0d, 0x41, 0x70,
+    0x70, 0x6c, 0x65, 0x20, 0x52, 0x6f, 0x6f, 0x74,
+    0x20, 0x43, 0x41, 0x30, 0x1e, 0x17, 0x0d, 0x30,
+    0x36, 0x30, 0x34, 0x32, 0x35, 0x32, 0x31, 0x34,
+    0x30, 0x33, 0x36, 0x5a, 0x17, 0x0d, 0x33, 0x35,
+    0x30, 0x32, 0x30, 0x39, 0x32, 0x31, 0x34, 0x30,
+    0x33, 0x36, 0x5a, 0x30, 0x62, 0x31, 0x0b, 0x30,
+    0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13, 0x02,
+    0x55, 0x53, 0x31, 0x13, 0x30, 0x11, 0x06, 0x03,
+    0x55, 0x04, 0x0a, 0x13, 0x0a, 0x41, 0x70, 0x70,
+    0x6c, 0x65, 0x20, 0x49, 0x6e, 0x63, 0x2e, 0x31,
+    0x26, 0x30, 0x24, 0x06, 0x03, 0x55, 0x04, 0x0b,
+    0x13, 0x1d, 0x41, 0x70, 0x70, 0x6c, 0x65, 0x20,
+    0x43, 0x65, 0x72, 0x74, 0x69, 0x66, 0x69, 0x63,
+    0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x41, 0x75,
+    0x74, 0x68, 0x6f, 0x72, 0x69, 0x74, 0x79, 0x31,
+    0x16, 0x30, 0x14, 0x06, 0x03, 0x55, 0x04, 0x03,
+    0x13, 0x0d, 0x41, 0x70, 0x70, 0x6c, 0x65, 0x20,
+    0x52, 0x6f, 0x6f, 0x74, 0x20, 0x43, 0x41, 0x30,
+    0x82, 0x01, 0x22, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+    0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01,
+    0x05, 0x00, 0x03, 0x82, 0x01, 0x0f, 0x00, 0x30,
+    0x82, 0x01, 0x0a, 0x02, 0x82, 0x01, 0x01, 0x00,
+    0xe4, 0x91, 0xa9, 0x09, 0x1f, 0x91, 0xdb, 0x1e,
+    0x47, 0x50, 0xeb, 0x05, 0xed, 0x5e, 0x79, 0x84,
+    0x2d, 0xeb, 0x36, 0xa2, 0x57, 0x4c, 0x55, 0xec,
+    0x8b, 0x19, 0x89, 0xde, 0xf9, 0x4b, 0x6c, 0xf5,
+    0x07, 0xab, 0x22, 0x30, 0x02, 0xe8, 0x18, 0x3e,
+    0xf8, 0x50, 0x09, 0xd3, 0x7f, 0x41, 0xa8, 0x98,
+    0xf9, 0xd1, 0xca, 0x66, 0x9c, 0x24, 0x6b, 0x11,
+    0xd0, 0xa3, 0xbb, 0xe4, 0x1b, 0x2a, 0xc3, 0x1f,
+    0x95, 0x9e, 0x7a, 0x0c, 0xa4, 0x47, 0x8b, 0x5b,
+    0xd4, 0x16, 0x37, 0x33, 0xcb, 0xc4, 0x0f, 0x4d,
+    0xce, 0x14, 0x69, 0xd1, 0xc9, 0x19, 0x72, 0xf5,
+    0x5d, 0x0e, 0xd5, 0x7f, 0x5f, 0x9b, 0xf2, 0x25,
+    0x03, 0xba, 0x55, 0x8f, 0x4d, 0x5d, 0x0d, 0xf1,
+    0x64, 0x35, 0x23, 0x15, 0x4b, 0x15, 0x59, 0x1d,
+    0xb3, 0x94, 0xf7, 0xf6, 0x9c, 0x9e, 0xcf, 0x50,
+    0xba, 0xc1, 0x58, 0x50, 0x67, 0x8f, 0x08, 0xb4,
+    0x20, 0xf7, 0xcb, 0xac, 0x2c, 0x20, 0x6f, 0x70,
+    0xb6, 0x3f, 0x01, 0x30, 0x8c, 0xb7, 0x43, 0xcf,
+    0x0f, 0x9d, 0x3d, 0xf3, 0x2b, 0x49, 0x28, 0x1a,
+    0xc8, 0xfe, 0xce, 0xb5, 0xb9, 0x0e, 0xd9, 0x5e,
+    0x1c, 0xd6, 0xcb, 0x3d, 0xb5, 0x3a, 0xad, 0xf4,
+    0x0f, 0x0e, 0x00, 0x92, 0x0b, 0xb1, 0x21, 0x16,
+    0x2e, 0x74, 0xd5, 0x3c, 0x0d, 0xdb, 0x62, 0x16,
+    0xab, 0xa3, 0x71, 0x92, 0x47, 0x53, 0x55, 0xc1,
+    0xaf, 0x2f, 0x41, 0xb3, 0xf8, 0xfb, 0xe3, 0x70,
+    0xcd, 0xe6, 0xa3, 0x4c, 0x45, 0x7e, 0x1f, 0x4c,
+    0x6b, 0x50, 0x96, 0x41, 0x89, 0xc4, 0x74, 0x62,
+    0x0b, 0x10, 0x83, 0x41, 0x87, 0x33, 0x8a, 0x81,
+    0xb1, 0x30, 0x58, 0xec, 0x5a, 0x04, 0x32, 0x8c,
+    0x68, 0xb3, 0x8f, 0x1d, 0xde, 0x65, 0x73, 0xff,
+    0x67, 0x5e, 0x65, 0xbc, 0x49, 0xd8, 0x76, 0x9f,
+    0x33, 0x14, 0x65, 0xa1, 0x77, 0x94, 0xc9, 0x2d,
+    0x02, 0x03, 0x01, 0x00, 0x01, 0xa3, 0x82, 0x01,
+    0x7a, 0x30, 0x82, 0x01, 0x76, 0x30, 0x0e, 0x06,
+    0x03, 0x55, 0x1d, 0x0f, 0x01, 0x01, 0xff, 0x04,
+    0x04, 0x03, 0x02, 0x01, 0x06, 0x30, 0x0f, 0x06,
+    0x03, 0x55, 0x1d, 0x13, 0x01, 0x01, 0xff, 0x04,
+    0x05, 0x30, 0x03, 0x01, 0x01, 0xff, 0x30, 0x1d,
+    0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04,
+    0x14, 0x2b, 0xd0, 0x69, 0x47, 0x94, 0x76, 0x09,
+    0xfe, 0xf4, 0x6b, 0x8d, 0x2e, 0x40, 0xa6, 0xf7,
+    0x47, 0x4d, 0x7f, 0x08, 0x5e, 0x30, 0x1f, 0x06,
+    0x03, 0x55, 0x1d, 0x23, 0x04, 0x18, 0x30, 0x16,
+    0x80, 0x14, 0x2b, 0xd0, 0x69, 0x47, 0x94, 0x76,
+    0x09, 0xfe, 0xf4, 0x6b, 0x8d, 0x2e, 0x40, 0xa6,
+    0xf7, 0x47, 0x4d, 0x7f, 0x08, 0x5e, 0x30, 0x82,
+    0x01, 0x11, 0x06, 0x03, 0x55, 0x1d, 0x20, 0x04,
+    0x82, 0x01, 0x08, 0x30, 0x82, 0x01, 0x04, 0x30,
+    0x82, 0x01, 0x00, 0x06, 0x09, 0x2a, 0x86, 0x48,
+    0x86, 0xf7, 0x63, 0x64, 0x05, 0x01, 0x30, 0x81,
+    0xf2, 0x30, 0x2a, 0x06, 0x08, 0x2b, 0x06, 0x01,
+    0x05, 0x05, 0x07, 0x02, 0x01, 0x16, 0x1e, 0x68,
+    0x74, 0x74, 0x70, 0x73, 0x3a, 0x2f, 0x2f, 0x77,
+    0x77, 0x77, 0x2e, 0x61, 0x70, 0x70, 0x6c, 0x65,
+    0x2e, 0x63, 0x6f, 0x6d, 0x2f, 0x61, 0x70, 0x70,
+    0x6c, 0x65, 0x63, 0x61, 0x2f, 0x30, 0x81, 0xc3,
+    0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07,
+    0x02, 0x02, 0x30, 0x81, 0xb6, 0x1a, 0x81, 0xb3,
+    0x52, 0x65, 0x6c, 0x69, 0x61, 0x6e, 0x63, 0x65,
+    0x20, 0x6f, 0x6e, 0x20, 0x74, 0x68, 0x69, 0x73,
+    0x20, 0x63, 0x65, 0x72, 0x74, 0x69, 0x66, 0x69,
+    0x63, 0x61, 0x74, 0x65, 0x20, 0x62, 0x79, 0x20,
+    0x61, 0x6e, 0x79, 0x20, 0x70, 0x61, 0x72, 0x74,
+    0x79, 0x20, 0x61, 0x73, 0x73, 0x75, 0x6d, 0x65,
+    0x73, 0x20, 0x61, 0x63, 0x63, 0x65, 0x70, 0x74,
+    0x61, 0x6e, 0x63, 0x65, 0x20, 0x6f, 0x66, 0x20,
+    0x74, 0x68, 0x65, 0x20, 0x74, 0x68, 0x65, 0x6e,
+    0x20, 0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61,
+    0x62, 0x6c, 0x65, 0x20, 0x73, 0x74, 0x61, 0x6e,
+    0x64, 0x61, 0x72, 0x64, 0x20, 0x74, 0x65, 0x72,
+    0x6d, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x63,
+    0x6f, 0x6e, 0x64, 0x69, 0x74, 0x69, 0x6f, 0x6e,
+    0x73, 0x20, 0x6f, 0x66, 0x20, 0x75, 0x73, 0x65,
+    0x2c, 0x20, 0x63, 0x65, 0x72, 0x74, 0x69, 0x66,
+    0x69, 0x63, 0x61, 0x74, 0x65, 0x20, 0x70, 0x6f,
+    0x6c, 0x69, 0x63, 0x79, 0x20, 0x61, 0x6e, 0x64,
+    0x20, 0x63, 0x65, 0x72, 0x74, 0x69, 0x66, 0x69,
+    0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x70,
+    0x72, 0x61, 0x63, 0x74, 0x69, 0x63, 0x65, 0x20,
+    0x73, 0x74, 0x61, 0x74, 0x65, 0x6d, 0x65, 0x6e,
+    0x74, 0x73, 0x2e, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+    0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x05,
+    0x05, 0x00, 0x03, 0x82, 0x01, 0x01, 0x00, 0x5c,
+    0x36, 0x99, 0x4c, 0x2d, 0x78, 0xb7, 0xed, 0x8c,
+    0x9b, 0xdc, 0xf3, 0x77, 0x9b, 0xf2, 0x76, 0xd2,
+    0x77, 0x30, 0x4f, 0xc1, 0x1f, 0x85, 0x83, 0x85,
+    0x1b, 0x99, 0x3d, 0x47, 0x37, 0xf2, 0xa9, 0x9b,
+    0x40, 0x8e, 0x2c, 0xd4, 0xb1, 0x90, 0x12, 0xd8,
+    0xbe, 0xf4, 0x73, 0x9b, 0xee, 0xd2, 0x64, 0x0f,
+    0xcb, 0x79, 0x4f, 0x34, 0xd8, 0xa2, 0x3e, 0xf9,
+    0x78, 0xff, 0x6b, 0xc8, 0x07, 0xec, 0x7d, 0x39,
+    0x83, 0x8b, 0x53, 0x20, 0xd3, 0x38, 0xc4, 0xb1,
+    0xbf, 0x9a, 0x4f, 0x0a, 0x6b, 0xff, 0x2b, 0xfc,
+    0x59, 0xa7, 0x05, 0x09, 0x7c, 0x17, 0x40, 0x56,
+    0x11, 0x1e, 0x74, 0xd3, 0xb7, 0x8b, 0x23, 0x3b,
+    0x47, 0xa3, 0xd5, 0x6f, 0x24, 0xe2, 0xeb, 0xd1,
+    0xb7, 0x70, 0xdf, 0x0f, 0x45, 0xe1, 0x27, 0xca,
+    0xf1, 0x6d, 0x78, 0xed, 0xe7, 0xb5, 0x17, 0x17,
+    0xa8, 0xdc, 0x7e, 0x22, 0x35, 0xca, 0x25, 0xd5,
+    0xd9, 0x0f, 0xd6, 0x6b, 0xd4, 0xa2, 0x24, 0x23,
+    0x11, 0xf7, 0xa1, 0xac, 0x8f, 0x73, 0x81, 0x60,
+    0xc6, 0x1b, 0x5b, 0x09, 0x2f, 0x92, 0xb2, 0xf8,
+    0x44, 0x48, 0xf0, 0x60, 0x38, 0x9e, 0x15, 0xf5,
+    0x3d, 0x26, 0x67, 0x20, 0x8a, 0x33, 0x6a, 0xf7,
+    0x0d, 0x82, 0xcf, 0xde, 0xeb, 0xa3, 0x2f, 0xf9,
+    0x53, 0x6a, 0x5b, 0x64, 0xc0, 0x63, 0x33, 0x77,
+    0xf7, 0x3a, 0x07, 0x2c, 0x56, 0xeb, 0xda, 0x0f,
+    0x21, 0x0e, 0xda, 0xba, 0x73, 0x19, 0x4f, 0xb5,
+    0xd9, 0x36, 0x7f, 0xc1, 0x87, 0x55, 0xd9, 0xa7,
+    0x99, 0xb9, 0x32, 0x42, 0xfb, 0xd8, 0xd5, 0x71,
+    0x9e, 0x7e, 0xa1, 0x52, 0xb7, 0x1b, 0xbd, 0x93,
+    0x42, 0x24, 0x12, 0x2a, 0xc7, 0x0f, 0x1d, 0xb6,
+    0x4d, 0x9c, 0x5e, 0x63, 0xc8, 0x4b, 0x80, 0x17,
+    0x50, 0xaa, 0x8a, 0xd5, 0xda, 0xe4, 0xfc, 0xd0,
+    0x09, 0x07, 0x37, 0xb0, 0x75, 0x75, 0x21,
+};
+
+static void tests(void)
+{
+    SecCertificateInternStatistics before, after;
+    SecCertificateRef cert0 = NULL, cert1 = NULL, cert2 = NULL, cert3 = NULL, cert4 = NULL;
+    CFDataRef der = NULL;
+
+    SecCertificateSetInterningEnabled(true);
+
+    isnt(cert0 = SecCertificateCreateWithBytes(NULL, _c0, sizeof(_c0)), NULL, "create cert0");
+    SecCertificateGetInternStatistics(&before);
+    isnt(cert1 = SecCertificateCreateWithBytes(NULL, _c0, sizeof(_c0)), NULL, "create cert1");
+    ok(cert0 == cert1, "identical DER returns the same instance");
+    SecCertificateGetInternStatistics(&after);
+    ok(after.hits == before.hits + 1, "hit counted");
+    ok(after.bytesShared == before.bytesShared + sizeof(_c0), "shared bytes counted");
+
+    isnt(der = CFDataCreate(NULL, _c0, sizeof(_c0)), NULL, "create der");
+    isnt(cert2 = SecCertificateCreateWithData(NULL, der), NULL, "create cert2 from data");
+    ok(cert2 == cert0, "SecCertificateCreateWithData returns the same instance");
+
+    isnt(cert3 = SecCertificateCreateWithKeychainItem(NULL, der, der), NULL, "create cert3 with keychain item");
+    ok(cert3 != cert0, "SecCertificateCreateWithKeychainItem returns a private instance");
+    ok(CFEqual(cert3, cert0), "private instance is equal to the interned one");
+
+    SecCertificateSetInterningEnabled(false);
+    isnt(cert4 = SecCertificateCreateWithBytes(NULL, _c0, sizeof(_c0)), NULL, "create cert4");
+    ok(cert4 != cert0, "disabling interning stops sharing");
+
+    CFReleaseNull(cert0);
+    CFReleaseNull(cert1);
+    CFReleaseNull(cert2);
+    CFReleaseNull(cert3);
+    CFReleaseNull(cert4);
+    CFReleaseNull(der);
+}
+
+int si_19_certificate_intern(int argc, char *const *argv)
+{
+    plan_tests(13);
+
+    tests();
+
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include <Security/SecCertificatePriv.h>
 #include <Security/SecPolicyPriv.h>
 #include <Security/CMSDecoder.h>
+#include <Security/CMSPrivate.h>
 #include <utilities/SecCFRelease.h>
 
 #include "shared_regressions.h"
@@ -40,11 +41,55 @@ static void tests(void)
     CFReleaseSafe(policy);
 }
 
+static void appendContent(void *arg, const char *buf, size_t len)
+{
+    CFDataAppendBytes((CFMutableDataRef)arg, (const UInt8 *)buf, (CFIndex)len);
+}
+
+/* Attached content delivered through CMSDecoderSetContentCallback matches what
+   CMSDecoderCopyContent returns otherwise, and the signature still verifies. */
+static void content_callback_tests(void)
+{
+    SecPolicyRef policy = SecPolicyCreateOSXProvisioningProfileSigning();
+    CMSDecoderRef decoder = NULL;
+    CFDataRef expected = NULL, content = NULL;
+    CFMutableDataRef streamed = CFDataCreateMutable(NULL, 0);
+    CMSSignerStatus signerStatus = kCMSSignerInvalidIndex;
+
+    ok_status(CMSDecoderCreate(&decoder), "create decoder");
+    ok_status(CMSDecoderUpdateMessage(decoder, _TestProvisioningProfile, sizeof(_TestProvisioningProfile)),
+              "update message");
+    ok_status(CMSDecoderFinalizeMessage(decoder), "finalize message");
+    ok_status(CMSDecoderCopyContent(decoder, &expected), "copy content");
+    CFReleaseNull(decoder);
+
+    ok_status(CMSDecoderCreate(&decoder), "create decoder");
+    ok_status(CMSDecoderSetContentCallback(decoder, appendContent, streamed), "set content callback");
+    ok_status(CMSDecoderUpdateMessage(decoder, _TestProvisioningProfile, sizeof(_TestProvisioningProfile)),
+              "update message");
+    is(CMSDecoderSetContentCallback(decoder, appendContent, streamed), errSecParam,
+       "content callback can't be set once decoding started");
+    ok_status(CMSDecoderFinalizeMessage(decoder), "finalize message");
+    ok(expected && CFEqual(expected, streamed), "streamed content matches buffered content");
+    ok_status(CMSDecoderCopyContent(decoder, &content), "copy content");
+    is(content, NULL, "no buffered content when streaming");
+    ok_status(CMSDecoderCopySignerStatus(decoder, 0, policy, true, &signerStatus, NULL, NULL),
+              "copy signer status");
+    is(signerStatus, kCMSSignerValid, "signer status valid");
+
+    CFReleaseSafe(content);
+    CFReleaseSafe(expected);
+    CFReleaseSafe(streamed);
+    CFReleaseSafe(decoder);
+    CFReleaseSafe(policy);
+}
+
 int si_26_cms_apple_signed_samples(int argc, char *const *argv)
 {
-    plan_tests(7);
+    plan_tests(7 + 14);
 
     tests();
+    content_callback_tests();
 
     return 0;
 }
@@ -74,6 +74,7 @@
 #include "AppleExternalRootCertificates.h"
 #include <Security/SecInternalReleasePriv.h>
 #include <CoreTrust/CTCompress.h>
+#include <stdatomic.h>
 
 #pragma clang diagnostic ignored "-Wformat=2"
 
@@ -1786,12 +1787,104 @@ badCert:
 }
 
 
+/************************************************************************/
+/************************ Certificate Interning **************************/
+/************************************************************************/
+
+/* A direct-mapped table of recently created certificates, indexed by the
+   SHA-256 of their DER. Each slot owns one reference. Readers take the slot
+   with an atomic exchange, inspect it, and put it back, so a certificate is
+   never released while another thread is looking at it and no lock is
+   needed. A reader that loses a race simply misses and parses. */
+#define kSecCertificateInternSlots 1024
+
+static _Atomic(SecCertificateRef) sInternTable[kSecCertificateInternSlots];
+static _Atomic(bool) sInternEnabled;
+static _Atomic(uint64_t) sInternHits;
+static _Atomic(uint64_t) sInternMisses;
+static _Atomic(uint64_t) sInternEvictions;
+static _Atomic(uint64_t) sInternBytesShared;
+
+void SecCertificateSetInterningEnabled(bool enabled) {
+    atomic_store(&sInternEnabled, enabled);
+    if (!enabled) {
+        for (size_t ix = 0; ix < kSecCertificateInternSlots; ix++) {
+            SecCertificateRef old = atomic_exchange(&sInternTable[ix], NULL);
+            CFReleaseSafe(old);
+        }
+    }
+}
+
+void SecCertificateGetInternStatistics(SecCertificateInternStatistics *stats) {
+    stats->hits = atomic_load_explicit(&sInternHits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&sInternMisses, memory_order_relaxed);
+    stats->evictions = atomic_load_explicit(&sInternEvictions, memory_order_relaxed);
+    stats->bytesShared = atomic_load_explicit(&sInternBytesShared, memory_order_relaxed);
+}
+
+/* Returns the table slot for der, or -1 if interning does not apply. */
+static CFIndex SecCertificateInternSlot(CFAllocatorRef allocator,
+    const UInt8 *der_bytes, CFIndex der_length) {
+    if (!atomic_load_explicit(&sInternEnabled, memory_order_relaxed)) {
+        return -1;
+    }
+    if (allocator != NULL && allocator != kCFAllocatorDefault) {
+        return -1;
+    }
+    uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+    uint64_t index;
+    CC_SHA256(der_bytes, (CC_LONG)der_length, digest);
+    memcpy(&index, digest, sizeof(index));
+    return (CFIndex)(index % kSecCertificateInternSlots);
+}
+
+static SecCertificateRef SecCertificateInternCopy(CFIndex slot,
+    const UInt8 *der_bytes, CFIndex der_length) {
+    SecCertificateRef interned = atomic_exchange(&sInternTable[slot], NULL);
+    if (!interned) {
+        atomic_fetch_add_explicit(&sInternMisses, 1, memory_order_relaxed);
+        return NULL;
+    }
+    SecCertificateRef result = NULL;
+    if (interned->_der.length == (size_t)der_length &&
+        !memcmp(interned->_der.data, der_bytes, (size_t)der_length)) {
+        result = (SecCertificateRef)CFRetain(interned);
+        atomic_fetch_add_explicit(&sInternHits, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&sInternBytesShared, (uint64_t)der_length, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&sInternMisses, 1, memory_order_relaxed);
+    }
+    SecCertificateRef expected = NULL;
+    if (!atomic_compare_exchange_strong(&sInternTable[slot], &expected, interned)) {
+        /* someone interned another certificate here while we held it */
+        CFRelease(interned);
+    }
+    return result;
+}
+
+static void SecCertificateInternInsert(CFIndex slot, SecCertificateRef certificate) {
+    CFRetain(certificate);
+    SecCertificateRef old = atomic_exchange(&sInternTable[slot], certificate);
+    if (old) {
+        atomic_fetch_add_explicit(&sInternEvictions, 1, memory_order_relaxed);
+        CFRelease(old);
+    }
+}
+
 /* Public API functions. */
 SecCertificateRef SecCertificateCreateWithBytes(CFAllocatorRef allocator,
 	const UInt8 *der_bytes, CFIndex der_length) {
 	if (der_bytes == NULL) return NULL;
     if (der_length <= 0) return NULL;
 
+    CFIndex slot = SecCertificateInternSlot(allocator, der_bytes, der_length);
+    if (slot >= 0) {
+        SecCertificateRef interned = SecCertificateInternCopy(slot, der_bytes, der_length);
+        if (interned) {
+            return interned;
+        }
+    }
+
     CFIndex size = (CFIndex)sizeof(struct __SecCertificate) + der_length - (CFIndex)sizeof(CFRuntimeBase);
     SecCertificateRef result = (SecCertificateRef)_CFRuntimeCreateInstance( allocator, SecCertificateGetTypeID(), size, 0);
 	if (result) {
@@ -1804,6 +1897,9 @@ SecCertificateRef SecCertificateCreateWithBytes(CFAllocatorRef allocator,
 			CFRelease(result);
 			return NULL;
 		}
+		if (slot >= 0) {
+			SecCertificateInternInsert(slot, result);
+		}
     }
     return result;
 }
@@ -1822,11 +1918,23 @@ SecCertificateRef SecCertificateCreate(CFAllocatorRef allocator,
    der_certificate is a caller provided data of any length (might be 0), only
    its cf type has been checked.
  */
-SecCertificateRef SecCertificateCreateWithData(CFAllocatorRef allocator,
-	CFDataRef der_certificate) {
+static SecCertificateRef SecCertificateCreateWithDataInternal(CFAllocatorRef allocator,
+	CFDataRef der_certificate, bool intern) {
 	if (!der_certificate || CFDataGetLength(der_certificate) < 0) {
 		return NULL;
 	}
+	CFIndex slot = -1;
+	if (intern && CFDataGetLength(der_certificate) > 0) {
+		slot = SecCertificateInternSlot(allocator, CFDataGetBytePtr(der_certificate),
+			CFDataGetLength(der_certificate));
+	}
+	if (slot >= 0) {
+		SecCertificateRef interned = SecCertificateInternCopy(slot,
+			CFDataGetBytePtr(der_certificate), CFDataGetLength(der_certificate));
+		if (interned) {
+			return interned;
+		}
+	}
 	CFIndex size = sizeof(struct __SecCertificate);
 	SecCertificateRef result = (SecCertificateRef)_CFRuntimeCreateInstance(
 		allocator, SecCertificateGetTypeID(), size - (CFIndex)sizeof(CFRuntimeBase), 0);
@@ -1839,15 +1947,24 @@ SecCertificateRef SecCertificateCreateWithData(CFAllocatorRef allocator,
 			CFRelease(result);
 			return NULL;
 		}
+		if (slot >= 0) {
+			SecCertificateInternInsert(slot, result);
+		}
 	}
 	return result;
 }
 
+SecCertificateRef SecCertificateCreateWithData(CFAllocatorRef allocator,
+	CFDataRef der_certificate) {
+	return SecCertificateCreateWithDataInternal(allocator, der_certificate, true);
+}
+
 SecCertificateRef SecCertificateCreateWithKeychainItem(CFAllocatorRef allocator,
 	CFDataRef der_certificate,
 	CFTypeRef keychain_item)
 {
-	SecCertificateRef result = SecCertificateCreateWithData(allocator, der_certificate);
+	/* Never hand out an interned instance: we're about to attach state to it. */
+	SecCertificateRef result = SecCertificateCreateWithDataInternal(allocator, der_certificate, false);
 	if (result) {
 		CFRetainSafe(keychain_item);
 		result->_keychain_item = keychain_item;
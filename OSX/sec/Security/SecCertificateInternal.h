@@ -182,6 +182,22 @@ CFArrayRef SecCertificateCopyLegacyProperties(SecCertificateRef certificate);
 /* Return PEM representation of the certificate. */
 CFStringRef SecCertificateCopyPEMRepresentation(SecCertificateRef certificate);
 
+/* Certificate interning. When enabled, SecCertificateCreateWithBytes and
+   SecCertificateCreateWithData return a shared, already parsed instance for
+   DER they have recently seen (keyed by its SHA-256) instead of parsing it
+   again. Only enable this in processes that never attach per-instance state
+   (e.g. SecCertificateSetKeychainItem) to certificates; trustd turns it on. */
+void SecCertificateSetInterningEnabled(bool enabled);
+
+typedef struct {
+    uint64_t hits;          /* creates satisfied by an interned certificate */
+    uint64_t misses;        /* creates that had to parse */
+    uint64_t evictions;     /* interned certificates displaced from the table */
+    uint64_t bytesShared;   /* DER bytes not duplicated thanks to hits */
+} SecCertificateInternStatistics;
+
+void SecCertificateGetInternStatistics(SecCertificateInternStatistics *stats);
+
 // MARK: -
 // MARK: Certificate Operations
 
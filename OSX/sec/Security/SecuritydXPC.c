@@ -29,6 +29,8 @@
 #include <utilities/SecDb.h>
 #include <utilities/SecCFWrappers.h>
 #include <utilities/der_plist.h>
+#include <utilities/der_plist_internal.h>
+#include <corecrypto/ccder.h>
 
 // TODO Shorten these string values to save ipc bandwidth.
 const char *kSecXPCKeyOperation = "operation";
@@ -330,6 +332,45 @@ bool SecXPCDictionarySetPListWithRepair(xpc_object_t message, const char *key, C
     return true;
 }
 
+bool SecXPCArrayBodyAppendValues(CFMutableDataRef body, CFArrayRef values, bool repair, CFErrorRef *error)
+{
+    for (CFIndex ix = 0; ix < CFArrayGetCount(values); ++ix) {
+        CFTypeRef value = CFArrayGetValueAtIndex(values, ix);
+        size_t size = der_sizeof_plist(value, error);
+        if (!size) {
+            return false;
+        }
+        CFIndex offset = CFDataGetLength(body);
+        CFDataIncreaseLength(body, (CFIndex)size);
+        uint8_t *der = CFDataGetMutableBytePtr(body) + offset;
+        if (der_encode_plist_repair(value, error, repair, der, der + size) != der) {
+            CFDataSetLength(body, offset);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SecXPCDictionarySetArrayBody(xpc_object_t message, const char *key, CFDataRef body, CFErrorRef *error)
+{
+    size_t body_size = (size_t)CFDataGetLength(body);
+    size_t size = ccder_sizeof(CCDER_CONSTRUCTED_SEQUENCE, body_size);
+    uint8_t *der = malloc(size);
+    uint8_t *der_end = der + size;
+    memcpy(der_end - body_size, CFDataGetBytePtr(body), body_size);
+    uint8_t *der_start = SecCCDEREncodeHandleResult(ccder_encode_constructed_tl(CCDER_CONSTRUCTED_SEQUENCE, der_end, der, der_end - body_size),
+                                                    error);
+    if (!der_start) {
+        free(der);
+        return false;
+    }
+
+    assert(der == der_start);
+    xpc_dictionary_set_data(message, key, der_start, (size_t)(der_end - der_start));
+    free(der);
+    return true;
+}
+
 bool SecXPCDictionarySetPListOptional(xpc_object_t message, const char *key, CFTypeRef object, CFErrorRef *error) {
     return !object || SecXPCDictionarySetPList(message, key, object, error);
 }
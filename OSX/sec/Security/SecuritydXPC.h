@@ -38,6 +38,11 @@ bool SecXPCDictionarySetPList(xpc_object_t message, const char *key, CFTypeRef o
 bool SecXPCDictionarySetPListWithRepair(xpc_object_t message, const char *key, CFTypeRef object, bool repair, CFErrorRef *error);
 bool SecXPCDictionarySetPListOptional(xpc_object_t message, const char *key, CFTypeRef object, CFErrorRef *error);
 
+// Send a CFArray without holding all of it at once: append the DER of each batch of values to body,
+// then set body; the receiver's SecXPCDictionaryCopyPList sees a single CFArray.
+bool SecXPCArrayBodyAppendValues(CFMutableDataRef body, CFArrayRef values, bool repair, CFErrorRef *error);
+bool SecXPCDictionarySetArrayBody(xpc_object_t message, const char *key, CFDataRef body, CFErrorRef *error);
+
 bool SecXPCDictionarySetString(xpc_object_t message, const char *key, CFStringRef string, CFErrorRef *error);
 bool SecXPCDictionarySetStringOptional(xpc_object_t message, const char *key, CFStringRef string, CFErrorRef *error);
 
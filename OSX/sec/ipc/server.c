@@ -509,10 +509,29 @@ static void securityd_xpc_dictionary_handler(const xpc_connection_t connection,
                     CFDictionaryRef query = SecXPCDictionaryCopyDictionary(event, kSecXPCKeyQuery, &error);
                     if (query) {
                         CFTypeRef result = NULL;
-                        if (_SecItemCopyMatching(query, &client, &result, &error) && result) {
-                            SecXPCDictionarySetPListWithRepair(replyMessage, kSecXPCKeyResult, result, true, &error);
-                            CFReleaseNull(result);
+                        // kSecMatchLimitAll results are encoded batch by batch, so only one batch of
+                        // decoded items is alive at a time.
+                        CFMutableDataRef resultBody = CFDataCreateMutable(kCFAllocatorDefault, 0);
+                        __block bool encoded = true;
+                        __block CFErrorRef encodeError = NULL;
+                        if (_SecItemCopyMatchingBatched(query, &client, &result, ^bool(CFArrayRef results) {
+                                encoded = SecXPCArrayBodyAppendValues(resultBody, results, true, &encodeError);
+                                return encoded;
+                            }, &error)) {
+                            if (!encoded) {
+                                if (CFErrorPropagate(encodeError, &error)) {
+                                    SecError(errSecInternal, &error, CFSTR("unable to encode query results"));
+                                }
+                                encodeError = NULL;
+                            } else if (result) {
+                                SecXPCDictionarySetPListWithRepair(replyMessage, kSecXPCKeyResult, result, true, &error);
+                            } else if (CFDataGetLength(resultBody) > 0) {
+                                SecXPCDictionarySetArrayBody(replyMessage, kSecXPCKeyResult, resultBody, &error);
+                            }
                         }
+                        CFReleaseNull(encodeError);
+                        CFReleaseNull(result);
+                        CFReleaseNull(resultBody);
                         CFReleaseNull(query);
                     }
                     break;
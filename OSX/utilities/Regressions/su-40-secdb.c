@@ -31,7 +31,7 @@
 #include "utilities_regressions.h"
 #include <time.h>
 
-#define kTestCount 32
+#define kTestCount 43
 
 static int count_func(SecDbRef db, const char *name, CFIndex *max_conn_count, bool (*perform)(SecDbRef db, CFErrorRef *error, void (^perform)(SecDbConnectionRef dbconn))) {
     __block int count = 0;
@@ -98,6 +98,61 @@ static void count_connections(SecDbRef db, size_t maxIdleHandles) {
 
 }
 
+static void group_commit(SecDbRef db) {
+    const size_t kWriters = 20;
+    __block CFErrorRef error = NULL;
+    ok(SecDbPerformWrite(db, &error, ^void (SecDbConnectionRef dbconn) {
+        ok(SecDbExec(dbconn, CFSTR("CREATE TABLE tableb(key INTEGER);"), &error), "exec: %@", error);
+    }), "SecDbPerformWrite: %@", error);
+    CFReleaseNull(error);
+
+    // Concurrent writers; the odd ones fail part way through and roll back
+    // their own transaction after already having written a row.
+    bool *committed = calloc(kWriters, sizeof(bool));
+    dispatch_apply(kWriters, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t ix) {
+        committed[ix] = SecDbPerformWriteTransaction(db, NULL, ^(SecDbConnectionRef dbconn, bool *commit) {
+            CFStringRef sql = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("INSERT INTO tableb(key)VALUES(%zu);"), ix);
+            *commit = SecDbExec(dbconn, sql, NULL);
+            CFReleaseNull(sql);
+            if (ix % 2) {
+                *commit = *commit && SecDbExec(dbconn, CFSTR("INSERT INTO nosuchtable(key)VALUES(0);"), NULL);
+            }
+        });
+    });
+    bool expected = true;
+    for (size_t ix = 0; ix < kWriters; ++ix) {
+        expected &= committed[ix] == ((ix % 2) == 0);
+    }
+    free(committed);
+    ok(expected, "each writer committed or rolled back on its own");
+
+    __block int rows = -1;
+    ok(SecDbPerformRead(db, &error, ^void (SecDbConnectionRef dbconn) {
+        SecDbPrepare(dbconn, CFSTR("SELECT COUNT(*) FROM tableb;"), &error, ^void (sqlite3_stmt *stmt) {
+            SecDbStep(dbconn, stmt, &error, ^(bool *stop) {
+                rows = sqlite3_column_int(stmt, 0);
+            });
+        });
+    }), "SecDbPerformRead: %@", error);
+    CFReleaseNull(error);
+    is(rows, (int)kWriters / 2, "only committed rows are present");
+
+    ok(SecDbPerformRead(db, &error, ^void (SecDbConnectionRef dbconn) {
+        SecDbPrepare(dbconn, CFSTR("SELECT COUNT(*) FROM tableb WHERE key % 2 = 0;"), &error, ^void (sqlite3_stmt *stmt) {
+            SecDbStep(dbconn, stmt, &error, ^(bool *stop) {
+                rows = sqlite3_column_int(stmt, 0);
+            });
+        });
+    }), "SecDbPerformRead: %@", error);
+    CFReleaseNull(error);
+    is(rows, (int)kWriters / 2, "every succeeding writer's row survived the failing ones");
+
+    ok(SecDbPerformWrite(db, &error, ^void (SecDbConnectionRef dbconn) {
+        SecDbExec(dbconn, CFSTR("DROP TABLE tableb;"), &error);
+    }), "SecDbPerformWrite: %@", error);
+    CFReleaseNull(error);
+}
+
 static void tests(size_t maxIdleHandles)
 {
     CFTypeID typeID = SecDbGetTypeID();
@@ -172,11 +227,25 @@ static void tests(size_t maxIdleHandles)
 
         }), "SecDbPrepare: %@", error);
 
+        // The second use of the same sql gets the statement the first one released.
+        __block sqlite3_stmt *firstStmt = NULL;
+        __block sqlite3_stmt *secondStmt = NULL;
+        ok(SecDbPrepare(dbconn, sql, &error, ^void (sqlite3_stmt *stmt) {
+            firstStmt = stmt;
+        }), "SecDbPrepare: %@", error);
+        ok(SecDbPrepare(dbconn, sql, &error, ^void (sqlite3_stmt *stmt) {
+            secondStmt = stmt;
+        }), "SecDbPrepare: %@", error);
+        ok(firstStmt != NULL && firstStmt == secondStmt, "statement reused from cache");
+        CFReleaseNull(error);
+
         ok(SecDbExec(dbconn, CFSTR("DROP TABLE tablea;"), &error),
            "exec: %@", error);
     }), "SecDbPerformWrite: %@", error);
     CFReleaseNull(error);
 
+    group_commit(db);
+
     count_connections(db, maxIdleHandles);
 
     CFReleaseNull(db);
@@ -37,6 +37,8 @@
 #include "SecCFError.h"
 #include "SecIOFormat.h"
 #include <stdio.h>
+#include <ctype.h>
+#include <strings.h>
 #include "Security/SecBase.h"
 #include "SecAutorelease.h"
 #include <os/assumes.h>
@@ -63,7 +65,12 @@ struct __OpaqueSecDbStatement {
 struct __OpaqueSecDbConnection {
     CFRuntimeBase _base;
 
-    //CFMutableDictionaryRef statements;
+    // Idle prepared statements, see SecDbCopyStmt() and SecDbReleaseCachedStmt().
+    CFMutableDictionaryRef statements;      // sql -> sqlite3_stmt * (not retained)
+    CFMutableArrayRef statementsLRU;        // sql, least recently used first
+    uint64_t statementHits;
+    uint64_t statementMisses;
+    uint64_t statementPrepares;
 
     SecDbRef db;     // NONRETAINED, since db or block retains us
     bool readOnly;
@@ -90,7 +97,8 @@ struct __OpaqueSecDb {
     dispatch_queue_t commitQueue;
 
     CFMutableArrayRef idleWriteConnections;     // up to kSecDbMaxWriters of them (currently 1, requires locking change for >1)
-    CFMutableArrayRef idleReadConnections;      // up to kSecDbMaxReaders of them
+    CFMutableArrayRef idleReadConnections;      // up to maxReaders of them
+    size_t maxReaders;
     pthread_mutex_t writeMutex;
     pthread_mutexattr_t writeMutexAttrs;
     // TODO: Replace after we have rdar://problem/60961964
@@ -107,6 +115,11 @@ struct __OpaqueSecDb {
     bool useRobotVacuum; /* use if SecDB should manage vacuum behind your back */
     uint8_t maxIdleHandles;
     void (^corruptionReset)(void);
+
+    // Callers of SecDbPerformWriteTransaction() waiting to be committed together; protected by queue.
+    struct SecDbWriteRequest *pendingWrites;
+    struct SecDbWriteRequest **pendingWritesTail;
+    bool writeGroupActive;  /* some caller is leading a group commit */
 };
 
 // MARK: Error domains and error helper functions
@@ -197,6 +210,7 @@ void _SecDbServerSetup(void)
 // MARK: Static helper functions
 
 static bool SecDbOpenHandle(SecDbConnectionRef dbconn, bool *created, CFErrorRef *error);
+static void SecDbConnectionFlushStatements(SecDbConnectionRef dbconn);
 static bool SecDbHandleCorrupt(SecDbConnectionRef dbconn, int rc, CFErrorRef *error);
 
 #pragma mark -
@@ -249,6 +263,13 @@ CFGiblisFor(SecDb)
 SecDbRef
 SecDbCreate(CFStringRef dbName, mode_t mode, bool readWrite, bool allowRepair, bool useWAL, bool useRobotVacuum, uint8_t maxIdleHandles,
                        bool (^opened)(SecDbRef db, SecDbConnectionRef dbconn, bool didCreate, bool *callMeAgainForNextConnection, CFErrorRef *error))
+{
+    return SecDbCreateWithOptions(dbName, mode, readWrite, allowRepair, useWAL, useRobotVacuum, maxIdleHandles, kSecDbMaxReaders, opened);
+}
+
+SecDbRef
+SecDbCreateWithOptions(CFStringRef dbName, mode_t mode, bool readWrite, bool allowRepair, bool useWAL, bool useRobotVacuum, uint8_t maxIdleHandles, uint8_t maxReaders,
+                       bool (^opened)(SecDbRef db, SecDbConnectionRef dbconn, bool didCreate, bool *callMeAgainForNextConnection, CFErrorRef *error))
 {
     SecDbRef db = NULL;
 
@@ -263,7 +284,8 @@ SecDbCreate(CFStringRef dbName, mode_t mode, bool readWrite, bool allowRepair, b
         db->commitQueue = dispatch_queue_create(cqNameStr, DISPATCH_QUEUE_CONCURRENT);
     });
     CFReleaseNull(commitQueueStr);
-    db->readSemaphore = dispatch_semaphore_create(kSecDbMaxReaders);
+    db->maxReaders = maxReaders > 0 ? maxReaders : kSecDbMaxReaders;
+    db->readSemaphore = dispatch_semaphore_create((long)db->maxReaders);
 
     bool mutexAttrSuccess =  (0 == pthread_mutexattr_init(&(db->writeMutexAttrs)));
     if(mutexAttrSuccess) {
@@ -296,6 +318,9 @@ SecDbCreate(CFStringRef dbName, mode_t mode, bool readWrite, bool allowRepair, b
     db->useRobotVacuum = useRobotVacuum;
     db->maxIdleHandles = maxIdleHandles;
     db->corruptionReset = NULL;
+    db->pendingWrites = NULL;
+    db->pendingWritesTail = &db->pendingWrites;
+    db->writeGroupActive = false;
 
 done:
     return db;
@@ -1103,6 +1128,11 @@ SecDbConnectionCreate(SecDbRef db, bool readOnly, CFErrorRef *error)
     dbconn->corruptionError = NULL;
     dbconn->handle = NULL;
     dbconn->changes = CFArrayCreateMutableForCFTypes(kCFAllocatorDefault);
+    dbconn->statements = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, NULL);
+    dbconn->statementsLRU = CFArrayCreateMutableForCFTypes(kCFAllocatorDefault);
+    dbconn->statementHits = 0;
+    dbconn->statementMisses = 0;
+    dbconn->statementPrepares = 0;
 
 done:
     return dbconn;
@@ -1320,7 +1350,7 @@ void SecDbConnectionRelease(SecDbConnectionRef dbconn) {
             CFIndex totalCachedConnections = CFArrayGetCount(db->idleReadConnections) + CFArrayGetCount(db->idleWriteConnections);
             CFMutableArrayRef cache = readOnly ? db->idleReadConnections : db->idleWriteConnections;
             CFIndex count = CFArrayGetCount(cache);
-            if ((unsigned long)count < (readOnly ? kSecDbMaxReaders : kSecDbMaxWriters) &&
+            if ((unsigned long)count < (readOnly ? db->maxReaders : kSecDbMaxWriters) &&
                 totalCachedConnections < db->maxIdleHandles) {
                 CFArrayAppendValue(cache, dbconn);
             } else if (db->maxIdleHandles >= kSecDbMaxIdleHandles) {
@@ -1356,6 +1386,7 @@ static void onQueueSecDbForceCloseForCache(CFMutableArrayRef cache) {
         // this pointer is claimed to be nonretained
         connection->db = NULL;
 
+        SecDbConnectionFlushStatements(connection);
         if(connection->handle) {
             sqlite3_close(connection->handle);
             connection->handle = NULL;
@@ -1398,6 +1429,147 @@ bool SecDbPerformWrite(SecDbRef db, CFErrorRef *error, void (^perform)(SecDbConn
     return success;
 }
 
+// MARK: -
+// MARK: Group commit
+
+/* One caller of SecDbPerformWriteTransaction(), living on that caller's stack. */
+typedef struct SecDbWriteRequest {
+    void (^transaction)(SecDbConnectionRef dbconn, bool *commit);
+    bool ok;
+    bool lead;                      // woken to lead the next group, not because we're done
+    CFErrorRef error;
+    dispatch_semaphore_t wakeup;
+    struct SecDbWriteRequest *next;
+} SecDbWriteRequest;
+
+/* Run one caller's transaction inside the group's, fenced by a savepoint so that
+   it commits or rolls back independently of the others.  Returns false if this
+   request's work could not be fenced off, in which case the group must not commit. */
+static bool SecDbPerformWriteRequest(SecDbConnectionRef dbconn, SecDbWriteRequest *request) {
+    CFIndex changeCount = CFArrayGetCount(dbconn->changes);
+    bool commit = true;
+
+    request->ok = SecDbExec(dbconn, CFSTR("SAVEPOINT SecDbWriteRequest"), &request->error);
+    if (!request->ok) {
+        return true;    // nothing of ours was written
+    }
+    request->transaction(dbconn, &commit);
+    if (sqlite3_get_autocommit(dbconn->handle)) {
+        // sqlite abandoned the whole transaction (e.g. SQLITE_FULL); nothing left to release.
+        request->ok = SecDbError(SQLITE_ABORT, &request->error, CFSTR("group transaction aborted"));
+        return false;
+    }
+    if (!commit) {
+        // Undo just this caller's work, and forget the changes it would have notified.
+        if (!SecDbExec(dbconn, CFSTR("ROLLBACK TO SecDbWriteRequest"), &request->error)) {
+            // Releasing now would commit our partial writes along with the group.
+            request->ok = false;
+            return false;
+        }
+        CFArrayReplaceValues(dbconn->changes, CFRangeMake(changeCount, CFArrayGetCount(dbconn->changes) - changeCount), NULL, 0);
+    }
+    if (!SecDbExec(dbconn, CFSTR("RELEASE SecDbWriteRequest"), &request->error)) {
+        request->ok = false;
+        return false;
+    }
+    request->ok = commit;
+    return true;
+}
+
+/* Commit a group of requests in a single transaction.  If that transaction doesn't
+   commit, none of them did. */
+static void SecDbCommitWriteGroup(SecDbRef db, SecDbWriteRequest *group) {
+    __block CFErrorRef groupError = NULL;
+    __block bool committed = false;
+    bool performed = SecDbPerformWrite(db, &groupError, ^(SecDbConnectionRef dbconn) {
+        committed = SecDbTransaction(dbconn, kSecDbExclusiveTransactionType, &groupError, ^(bool *commit) {
+            for (SecDbWriteRequest *request = group; request; request = request->next) {
+                if (!SecDbPerformWriteRequest(dbconn, request)) {
+                    *commit = false;
+                    break;
+                }
+            }
+        });
+    });
+    if (!performed || !committed) {
+        if (!groupError) {
+            SecDbError(SQLITE_ABORT, &groupError, CFSTR("group transaction rolled back"));
+        }
+        for (SecDbWriteRequest *request = group; request; request = request->next) {
+            if (request->ok || !request->error) {
+                request->ok = false;
+                CFReleaseNull(request->error);
+                request->error = (CFErrorRef)CFRetainSafe(groupError);
+            }
+        }
+    }
+    CFReleaseNull(groupError);
+}
+
+/* We lead: take everyone waiting (our own request first), commit them together,
+   then wake them and hand the lead to whoever queued up meanwhile. */
+static void SecDbLeadWriteGroup(SecDbRef db) {
+    __block SecDbWriteRequest *group = NULL;
+    dispatch_sync(db->queue, ^{
+        SecDbWriteRequest **tail = &db->pendingWrites;
+        for (size_t count = 0; *tail && count < kSecDbMaxWriteGroup; ++count) {
+            tail = &(*tail)->next;
+        }
+        group = db->pendingWrites;
+        db->pendingWrites = *tail;
+        *tail = NULL;
+        if (!db->pendingWrites) {
+            db->pendingWritesTail = &db->pendingWrites;
+        }
+    });
+
+    SecDbCommitWriteGroup(db, group);
+
+    dispatch_sync(db->queue, ^{
+        if (db->pendingWrites) {
+            db->pendingWrites->lead = true;
+            dispatch_semaphore_signal(db->pendingWrites->wakeup);
+        } else {
+            db->writeGroupActive = false;
+        }
+    });
+    // The leader's own request is first in the group; it isn't waiting to be woken.
+    for (SecDbWriteRequest *request = group->next, *next; request; request = next) {
+        next = request->next;   // request is gone once woken
+        dispatch_semaphore_signal(request->wakeup);
+    }
+}
+
+bool SecDbPerformWriteTransaction(SecDbRef db, CFErrorRef *error, void (^transaction)(SecDbConnectionRef dbconn, bool *commit)) {
+    if (!db) {
+        SecError(errSecNotAvailable, error, CFSTR("failed to get a db handle"));
+        return false;
+    }
+    SecDbWriteRequest request = {
+        .transaction = transaction,
+        .wakeup = dispatch_semaphore_create(0),
+    };
+    SecDbWriteRequest *req = &request;
+    __block bool lead = false;
+    dispatch_sync(db->queue, ^{
+        *db->pendingWritesTail = req;
+        db->pendingWritesTail = &req->next;
+        if (!db->writeGroupActive) {
+            db->writeGroupActive = true;
+            lead = true;
+        }
+    });
+    if (!lead) {
+        dispatch_semaphore_wait(request.wakeup, DISPATCH_TIME_FOREVER);
+        lead = request.lead;
+    }
+    if (lead) {
+        SecDbLeadWriteGroup(db);
+    }
+    dispatch_release(request.wakeup);
+    return CFErrorPropagate(request.error, error) && request.ok;
+}
+
 static CFStringRef
 SecDbConnectionCopyFormatDescription(CFTypeRef value, CFDictionaryRef formatOptions)
 {
@@ -1410,6 +1582,13 @@ static void
 SecDbConnectionDestroy(CFTypeRef value)
 {
     SecDbConnectionRef dbconn = (SecDbConnectionRef)value;
+    if (dbconn->statementPrepares) {
+        secinfo("#SecDB", "statement cache: %llu hits, %llu misses, %llu prepares",
+                dbconn->statementHits, dbconn->statementMisses, dbconn->statementPrepares);
+    }
+    SecDbConnectionFlushStatements(dbconn);
+    CFReleaseNull(dbconn->statements);
+    CFReleaseNull(dbconn->statementsLRU);
     if (dbconn->handle) {
         int s3e = sqlite3_close(dbconn->handle);
         if (s3e != SQLITE_OK) {
@@ -1575,6 +1754,7 @@ sqlite3_stmt *SecDbPrepareV2(SecDbConnectionRef dbconn, const char *sql, size_t
     int ntries = 0;
     for (;;) {
         sqlite3_stmt *stmt = NULL;
+        dbconn->statementPrepares++;
         int s3e = sqlite3_prepare_v2(db, sql, (int)sqlLen, &stmt, sqlTail);
         if (s3e == SQLITE_OK)
             return stmt;
@@ -1598,10 +1778,94 @@ static sqlite3_stmt *SecDbCopyStatementWithTailRange(SecDbConnectionRef dbconn,
     return stmt;
 }
 
+// MARK: -
+// MARK: Statement cache
+
+/* Is stmt a schema change?  Those are run once, and invalidate what we cached. */
+static bool SecDbStmtIsSchemaChange(sqlite3_stmt *stmt) {
+    if (sqlite3_stmt_readonly(stmt)) {
+        return false;
+    }
+    const char *sql = sqlite3_sql(stmt);
+    if (!sql) {
+        return false;
+    }
+    while (isspace(*sql)) {
+        sql++;
+    }
+    return strncasecmp(sql, "CREATE", 6) == 0 || strncasecmp(sql, "DROP", 4) == 0 ||
+           strncasecmp(sql, "ALTER", 5) == 0;
+}
+
+/* Was stmt prepared from all of sql, as opposed to just its first statement? */
+static bool SecDbStmtIsAllOfSQL(sqlite3_stmt *stmt, CFStringRef sql) {
+    const char *stmtSql = sqlite3_sql(stmt);
+    __block bool result = false;
+    if (stmtSql) CFStringPerformWithCStringAndLength(sql, ^(const char *sqlStr, size_t sqlLen) {
+        result = strlen(stmtSql) == sqlLen && memcmp(stmtSql, sqlStr, sqlLen) == 0;
+    });
+    return result;
+}
+
+static void SecDbConnectionFlushStatements(SecDbConnectionRef dbconn) {
+    if (!dbconn->statements) {
+        return;
+    }
+    CFDictionaryForEach(dbconn->statements, ^(const void *key, const void *value) {
+        sqlite3_finalize((sqlite3_stmt *)value);
+    });
+    CFDictionaryRemoveAllValues(dbconn->statements);
+    CFArrayRemoveAllValues(dbconn->statementsLRU);
+}
+
+/* Take the idle statement for sql out of the cache, if there is one.  While the caller
+   has it, a nested use of the same sql prepares another one. */
+static sqlite3_stmt *SecDbConnectionCheckOutStatement(SecDbConnectionRef dbconn, CFStringRef sql) {
+    sqlite3_stmt *stmt = dbconn->statements ? (sqlite3_stmt *)CFDictionaryGetValue(dbconn->statements, sql) : NULL;
+    if (stmt) {
+        CFIndex ix = CFArrayGetFirstIndexOfValue(dbconn->statementsLRU, CFRangeMake(0, CFArrayGetCount(dbconn->statementsLRU)), sql);
+        if (ix != kCFNotFound) {
+            CFArrayRemoveValueAtIndex(dbconn->statementsLRU, ix);
+        }
+        CFDictionaryRemoveValue(dbconn->statements, sql);
+        dbconn->statementHits++;
+    } else {
+        dbconn->statementMisses++;
+    }
+    return stmt;
+}
+
+/* Keep a reset statement for reuse, evicting the least recently used one if needed.
+   Returns false if the caller should finalize stmt instead. */
+static bool SecDbConnectionCheckInStatement(SecDbConnectionRef dbconn, CFStringRef sql, sqlite3_stmt *stmt) {
+    if (!dbconn->statements || !dbconn->handle || CFDictionaryContainsKey(dbconn->statements, sql)) {
+        return false;
+    }
+    if (SecDbStmtIsSchemaChange(stmt) || !SecDbStmtIsAllOfSQL(stmt, sql)) {
+        return false;
+    }
+    if (CFArrayGetCount(dbconn->statementsLRU) >= kSecDbMaxCachedStatements) {
+        CFStringRef oldest = CFArrayGetValueAtIndex(dbconn->statementsLRU, 0);
+        sqlite3_finalize((sqlite3_stmt *)CFDictionaryGetValue(dbconn->statements, oldest));
+        CFDictionaryRemoveValue(dbconn->statements, oldest);
+        CFArrayRemoveValueAtIndex(dbconn->statementsLRU, 0);
+    }
+    CFDictionarySetValue(dbconn->statements, sql, stmt);
+    CFArrayAppendValue(dbconn->statementsLRU, sql);
+    return true;
+}
+
 sqlite3_stmt *SecDbCopyStmt(SecDbConnectionRef dbconn, CFStringRef sql, CFStringRef *tail, CFErrorRef *error) {
-    // TODO: Add caching and cache lookup of statements
+    sqlite3_stmt *stmt = sql ? SecDbConnectionCheckOutStatement(dbconn, sql) : NULL;
+    if (stmt) {
+        return stmt;
+    }
     CFRange sqlTail = {};
-    sqlite3_stmt *stmt = SecDbCopyStatementWithTailRange(dbconn, sql, &sqlTail, error);
+    stmt = SecDbCopyStatementWithTailRange(dbconn, sql, &sqlTail, error);
+    if (stmt && SecDbStmtIsSchemaChange(stmt)) {
+        /* Don't leave plans for the old schema lying around. */
+        SecDbConnectionFlushStatements(dbconn);
+    }
     if (sqlTail.length > 0) {
         CFStringRef excess = CFStringCreateWithSubstring(CFGetAllocator(sql), sql, sqlTail);
         if (tail) {
@@ -1618,14 +1882,26 @@ sqlite3_stmt *SecDbCopyStmt(SecDbConnectionRef dbconn, CFStringRef sql, CFString
     return stmt;
 }
 
-/*
- TODO: Could do a hack here with a custom kCFAllocatorNULL allocator for a second CFRuntimeBase inside a SecDbStatement,
- TODO: Better yet make a full blow SecDbStatement instance whenever SecDbCopyStmt is called.  Then, when the statement is released, in the Dispose method, we Reset and ClearBindings the sqlite3_stmt * and hand it back to the SecDb with the original CFStringRef for the sql (or hash thereof) as an argument. */
+/* Reset stmt and hand it back to dbconn's statement cache, or finalize it if it can't be
+   cached.  Either way a failure of its last step is reported, as sqlite3_finalize() would. */
 bool SecDbReleaseCachedStmt(SecDbConnectionRef dbconn, CFStringRef sql, sqlite3_stmt *stmt, CFErrorRef *error) {
-    if (stmt) {
+    if (!stmt) {
+        return true;
+    }
+    if (!dbconn || !sql) {
         return SecDbFinalize(stmt, error);
     }
-    return true;
+    int s3e = sqlite3_reset(stmt);
+    if (s3e != SQLITE_OK) {
+        bool ok = SecDbErrorWithStmt(s3e, stmt, error, CFSTR("reset: %p"), stmt);
+        sqlite3_finalize(stmt);
+        return ok;
+    }
+    sqlite3_clear_bindings(stmt);
+    if (SecDbConnectionCheckInStatement(dbconn, sql, stmt)) {
+        return true;
+    }
+    return SecDbFinalize(stmt, error);
 }
 
 bool SecDbPrepare(SecDbConnectionRef dbconn, CFStringRef sql, CFErrorRef *error, void(^exec)(sqlite3_stmt *stmt)) {
@@ -99,6 +99,13 @@ SecDbCreate(CFStringRef dbName, mode_t mode,
             bool readWrite, bool allowRepair, bool useWAL, bool useRobotVacuum, uint8_t maxIdleHandles,
             bool (^opened)(SecDbRef db, SecDbConnectionRef dbconn, bool didCreate, bool *callMeAgainForNextConnection, CFErrorRef *error));
 
+// As SecDbCreate, but with the number of concurrent read connections chosen by the caller
+// (SecDbCreate uses kSecDbMaxReaders).  There is always a single writer.
+SecDbRef
+SecDbCreateWithOptions(CFStringRef dbName, mode_t mode,
+                       bool readWrite, bool allowRepair, bool useWAL, bool useRobotVacuum, uint8_t maxIdleHandles, uint8_t maxReaders,
+                       bool (^opened)(SecDbRef db, SecDbConnectionRef dbconn, bool didCreate, bool *callMeAgainForNextConnection, CFErrorRef *error));
+
 void SecDbAddNotifyPhaseBlock(SecDbRef db, SecDBNotifyBlock notifyPhase);
 void SecDbSetCorruptionReset(SecDbRef db, void (^corruptionReset)(void));
 
@@ -113,6 +120,12 @@ void SecDbConnectionRelease(SecDbConnectionRef dbconn);
 bool SecDbPerformRead(SecDbRef db, CFErrorRef *error, void (^perform)(SecDbConnectionRef dbconn));
 bool SecDbPerformWrite(SecDbRef db, CFErrorRef *error, void (^perform)(SecDbConnectionRef dbconn));
 
+// Perform a small write transaction.  Concurrent callers are committed together in a single
+// sqlite transaction; each caller's transaction still commits, or rolls back if it clears
+// *commit, on its own, and its changes are notified with the group's.  Returns true if this
+// caller's transaction was committed.  Don't call this while holding a write connection.
+bool SecDbPerformWriteTransaction(SecDbRef db, CFErrorRef *error, void (^transaction)(SecDbConnectionRef dbconn, bool *commit));
+
 // TODO: DEBUG only -> Private header
 CFIndex SecDbIdleConnectionCount(SecDbRef db);
 void SecDbReleaseAllConnections(SecDbRef db);
@@ -16,4 +16,10 @@ static const size_t kSecDbMaxIdleHandles = 6;
 // fewer cached open sqlite connections.
 static const size_t kSecDbTrustdMaxIdleHandles = 2;
 
+// Most SecDbPerformWriteTransaction() callers committed in one sqlite transaction.
+static const size_t kSecDbMaxWriteGroup = 16;
+
+// Idle prepared statements kept per connection, keyed by their sql.
+static const CFIndex kSecDbMaxCachedStatements = 32;
+
 #endif /* SecDbInternal_h */
@@ -612,7 +612,8 @@ enum
 
 enum cssm_appledl_open_parameters_mask
 {
-	kCSSM_APPLEDL_MASK_MODE =			(1 << 0)
+	kCSSM_APPLEDL_MASK_MODE =			(1 << 0),
+	kCSSM_APPLEDL_MASK_APPEND_LOG =		(1 << 1)
 };
 
 /* Pass a CSSM_APPLEDL_OPEN_PARAMETERS_PTR as the OpenParameters argument to
@@ -638,6 +639,10 @@ typedef struct cssm_appledl_open_parameters
 
 	/* When calling DbCreate, the initial mode to create the database file with; ignored on DbOpen.  You must set the kCSSM_APPLEDL_MASK_MODE bit in mask or mode is ignored.  */
 	mode_t mode;
+
+	/* Set the kCSSM_APPLEDL_MASK_APPEND_LOG bit in mask when calling DbCreate to create a database whose small
+	   commits are appended to the end of the file instead of rewriting it; ignored on DbOpen.  Releases that
+	   predate the append log refuse to open such databases.  */
 } CSSM_APPLEDL_OPEN_PARAMETERS, *CSSM_APPLEDL_OPEN_PARAMETERS_PTR;
 
 
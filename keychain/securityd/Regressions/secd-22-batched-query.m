@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#import <Foundation/Foundation.h>
+#import <Security/SecItem.h>
+#import <Security/SecItemPriv.h>
+#import <utilities/SecCFWrappers.h>
+#import "keychain/securityd/SecItemServer.h"
+#import "keychain/securityd/SecItemDb.h"
+#import "keychain/securityd/SecDbQuery.h"
+#import "ipc/securityd_client.h"
+#import <Security/SecuritydXPC.h>
+
+#include "secd_regressions.h"
+#include "SecdTestKeychainUtilities.h"
+
+#define kItemCount 10
+#define kBatchSize 4
+
+int
+secd_22_batched_query(int argc, char *const *argv)
+{
+    plan_tests(kSecdTestSetupTestCount + kItemCount + 10);
+
+    secd_test_setup_temp_keychain("secd_22_batched_query", NULL);
+
+    for (int i = 0; i < kItemCount; i++) {
+        NSString *account = [NSString stringWithFormat:@"batched-%d", i];
+        is(SecItemAdd((__bridge CFDictionaryRef)@{
+            (id)kSecClass : (id)kSecClassGenericPassword,
+            (id)kSecAttrService : @"secd_22_batched_query",
+            (id)kSecAttrAccount : account,
+            (id)kSecValueData : [NSData dataWithBytes:"password" length:8],
+        }, NULL), errSecSuccess, "SecItemAdd(%@)", account);
+    }
+
+    SecurityClient *client = SecSecurityClientGet();
+    CFErrorRef error = NULL;
+    Query *q = query_create_with_limit((__bridge CFDictionaryRef)@{
+        (id)kSecClass : (id)kSecClassGenericPassword,
+        (id)kSecAttrService : @"secd_22_batched_query",
+        (id)kSecReturnAttributes : @YES,
+        (id)kSecReturnPersistentRef : @YES,
+    }, client->musr, kSecMatchUnlimited, client, &error);
+    query_set_caller_access_groups(q, client->accessGroups);
+
+    NSMutableArray *sizes = [NSMutableArray array];
+    __block bool leakedPersistentRef = false;
+    bool success = kc_with_dbt(false, &error, ^bool(SecDbConnectionRef dbt) {
+        return s3dl_copy_matching_batched(dbt, q, client->accessGroups, kBatchSize, &error, ^bool(CFArrayRef results) {
+            [sizes addObject:@(CFArrayGetCount(results))];
+            for (NSDictionary *item in (__bridge NSArray *)results) {
+                // the internal reference must already be gone when the batch is handed over
+                if (item[(id)kSecAttrPersistentReference] != nil)
+                    leakedPersistentRef = true;
+            }
+            return true;
+        });
+    });
+    ok(success, "s3dl_copy_matching_batched: %@", error);
+    CFReleaseNull(error);
+    is([[sizes valueForKeyPath:@"@sum.self"] intValue], kItemCount, "all items returned");
+    ok([sizes isEqual:(@[ @kBatchSize, @kBatchSize, @(kItemCount - 2 * kBatchSize) ])], "batch sizes: %@", sizes);
+    ok(!leakedPersistentRef, "no batched item carries kSecAttrPersistentReference");
+    ok(query_destroy(q, &error), "query_destroy: %@", error);
+    CFReleaseNull(error);
+
+    // The server's SecItemCopyMatching path: kSecMatchLimitAll is streamed into the reply
+    // and must arrive as the same array the unbatched call returns.
+    NSDictionary *allQuery = @{
+        (id)kSecClass : (id)kSecClassGenericPassword,
+        (id)kSecAttrService : @"secd_22_batched_query",
+        (id)kSecMatchLimit : (id)kSecMatchLimitAll,
+        (id)kSecReturnAttributes : @YES,
+    };
+    CFTypeRef expected = NULL;
+    ok(_SecItemCopyMatching((__bridge CFDictionaryRef)allQuery, client, &expected, &error), "_SecItemCopyMatching: %@", error);
+    CFReleaseNull(error);
+
+    CFTypeRef result = NULL;
+    CFMutableDataRef body = CFDataCreateMutable(kCFAllocatorDefault, 0);
+    __block int batches = 0;
+    ok(_SecItemCopyMatchingBatched((__bridge CFDictionaryRef)allQuery, client, &result, ^bool(CFArrayRef results) {
+        batches++;
+        return SecXPCArrayBodyAppendValues(body, results, true, NULL);
+    }, &error), "_SecItemCopyMatchingBatched: %@", error);
+    CFReleaseNull(error);
+    ok(result == NULL && batches == 1, "results streamed to the batch (%d batches)", batches);
+
+    xpc_object_t reply = xpc_dictionary_create(NULL, NULL, 0);
+    ok(SecXPCDictionarySetArrayBody(reply, kSecXPCKeyResult, body, &error), "SecXPCDictionarySetArrayBody: %@", error);
+    CFReleaseNull(error);
+    CFTypeRef decoded = SecXPCDictionaryCopyPList(reply, kSecXPCKeyResult, &error);
+    ok(CFEqualSafe(decoded, expected), "streamed reply decodes to the unbatched result: %@", error);
+    CFReleaseNull(error);
+    CFReleaseNull(decoded);
+    CFReleaseNull(body);
+    CFReleaseNull(expected);
+
+    secd_test_teardown_delete_temp_keychain("secd_22_batched_query");
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#import <Foundation/Foundation.h>
+#import <Security/SecItem.h>
+#import <Security/SecItemPriv.h>
+#import <utilities/SecCFWrappers.h>
+
+#include "secd_regressions.h"
+#include "SecdTestKeychainUtilities.h"
+
+/* SecItemAdd, SecItemUpdate and SecItemDelete are group-committed when they
+   race; each caller must still succeed or fail on its own. */
+
+#define kWriterCount 16
+
+static NSDictionary *itemQuery(size_t i) {
+    return @{
+        (id)kSecClass : (id)kSecClassGenericPassword,
+        (id)kSecAttrService : @"secd_23_concurrent_writes",
+        (id)kSecAttrAccount : [NSString stringWithFormat:@"writer-%zu", i],
+    };
+}
+
+/* Run op for every writer at once; returns how many got the expected status. */
+static int concurrently(OSStatus expected, OSStatus (^op)(size_t i)) {
+    __block _Atomic(int) matched = 0;
+    dispatch_apply(kWriterCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        if (op(i) == expected)
+            matched++;
+    });
+    return matched;
+}
+
+int
+secd_23_concurrent_writes(int argc, char *const *argv)
+{
+    plan_tests(kSecdTestSetupTestCount + 6);
+
+    secd_test_setup_temp_keychain("secd_23_concurrent_writes", NULL);
+
+    is(concurrently(errSecSuccess, ^OSStatus(size_t i) {
+        NSMutableDictionary *add = [itemQuery(i) mutableCopy];
+        add[(id)kSecValueData] = [NSData dataWithBytes:"password" length:8];
+        return SecItemAdd((__bridge CFDictionaryRef)add, NULL);
+    }), kWriterCount, "concurrent adds all succeed");
+
+    // Odd writers collide with their own item; that must not roll back the even ones.
+    is(concurrently(errSecSuccess, ^OSStatus(size_t i) {
+        NSMutableDictionary *add = [itemQuery(i) mutableCopy];
+        if (i % 2 == 0)
+            add[(id)kSecAttrAccount] = [NSString stringWithFormat:@"writer-%zu-again", i];
+        add[(id)kSecValueData] = [NSData dataWithBytes:"password" length:8];
+        return SecItemAdd((__bridge CFDictionaryRef)add, NULL);
+    }), kWriterCount / 2, "only the non-duplicate adds succeed");
+
+    is(concurrently(errSecSuccess, ^OSStatus(size_t i) {
+        return SecItemUpdate((__bridge CFDictionaryRef)itemQuery(i),
+                             (__bridge CFDictionaryRef)@{ (id)kSecAttrLabel : @"updated" });
+    }), kWriterCount, "concurrent updates all succeed");
+
+    is(concurrently(errSecSuccess, ^OSStatus(size_t i) {
+        return SecItemDelete((__bridge CFDictionaryRef)itemQuery(i));
+    }), kWriterCount, "concurrent deletes all succeed");
+
+    CFTypeRef results = NULL;
+    is(SecItemCopyMatching((__bridge CFDictionaryRef)@{
+        (id)kSecClass : (id)kSecClassGenericPassword,
+        (id)kSecAttrService : @"secd_23_concurrent_writes",
+        (id)kSecMatchLimit : (id)kSecMatchLimitAll,
+        (id)kSecReturnAttributes : @YES,
+    }, &results), errSecSuccess, "SecItemCopyMatching");
+    is(results ? (int)CFArrayGetCount(results) : 0, kWriterCount / 2, "exactly the non-duplicate second adds remain");
+    CFReleaseNull(results);
+
+    secd_test_teardown_delete_temp_keychain("secd_23_concurrent_writes");
+    return 0;
+}
@@ -32,6 +32,8 @@ DISABLED_ONE_TEST(secd_04_corrupted_items)
 ONE_TEST(secd_05_corrupted_items)
 ONE_TEST(secd_20_keychain_upgrade)
 ONE_TEST(secd_21_transmogrify)
+ONE_TEST(secd_22_batched_query)
+ONE_TEST(secd_23_concurrent_writes)
 DISABLED_ONE_TEST(secd_30_keychain_upgrade) //obsolete, needs updating
 DISABLED_ONE_TEST(secd_31_keychain_unreadable)
 OFF_ONE_TEST(secd_32_restore_bad_backup)
@@ -438,6 +438,11 @@ struct s3dl_query_ctx {
     SecDbConnectionRef dbt;
     CFTypeRef result;
     int found;
+    /* When set, results are handed to batch every batchSize rows instead of
+       being accumulated in result for the whole query. */
+    CFIndex batchSize;
+    bool (^batch)(CFArrayRef results);
+    bool stopped;
 };
 
 /* Return whatever the caller requested based on the value of q->q_return_type.
@@ -550,6 +555,19 @@ out:
     return equalOID;
 }
 
+/* Hand the results accumulated so far to the batch consumer and start a fresh
+   array, so only one batch worth of decoded items is alive at any time. */
+static void s3dl_query_flush_batch(struct s3dl_query_ctx *c) {
+    CFMutableArrayRef results = (CFMutableArrayRef)c->result;
+    if (c->stopped || CFArrayGetCount(results) == 0)
+        return;
+
+    c->result = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks);
+    if (!c->batch(results))
+        c->stopped = true;
+    CFRelease(results);
+}
+
 static void s3dl_query_row(sqlite3_stmt *stmt, void *context) {
     struct s3dl_query_ctx *c = context;
     Query *q = c->q;
@@ -662,7 +680,7 @@ decode:
             /* Caller wasn't interested in a result, but we still
              count this row as found. */
             CFRelease(a_result);  // Help shut up clang
-        } else if (q->q_limit == 1) {
+        } else if (q->q_limit == 1 && !c->batch) {
             c->result = a_result;
         } else {
             CFArrayAppendValue((CFMutableArrayRef)c->result, a_result);
@@ -675,6 +693,11 @@ decode:
         CFDictionaryRemoveValue(item, kSecAttrPersistentReference);
     }
 
+    /* Flush only once item is final: multi-value results hold item itself. */
+    if (c->batch && CFArrayGetCount(c->result) >= c->batchSize) {
+        s3dl_query_flush_batch(c);
+    }
+
 out:
     q->q_return_type = saved_mask;
     CFReleaseSafe(item);
@@ -1019,7 +1042,7 @@ s3dl_query(s3dl_handle_row handle_row,
     }
 
 	/* Actual work here. */
-    if (q->q_limit == 1) {
+    if (q->q_limit == 1 && !c->batch) {
         c->result = NULL;
     } else {
         c->result = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks);
@@ -1047,6 +1070,7 @@ s3dl_query(s3dl_handle_row handle_row,
 
                 bool stop = q->q_limit != kSecMatchUnlimited && c->found >= q->q_limit;
                 stop = stop || (q->q_error && !needs_auth);
+                stop = stop || c->stopped;
                 return !stop;
             });
         }
@@ -1069,13 +1093,9 @@ s3dl_query(s3dl_handle_row handle_row,
     return ok;
 }
 
-bool
-s3dl_copy_matching(SecDbConnectionRef dbt, Query *q, CFTypeRef *result,
-                   CFArrayRef accessGroups, CFErrorRef *error)
+static bool
+s3dl_prepare_matching_query(Query *q, CFErrorRef *error)
 {
-    struct s3dl_query_ctx ctx = {
-        .q = q, .accessGroups = accessGroups, .dbt = dbt,
-    };
     if (SecKeychainIsStaticPersistentRefsEnabled() && q->q_uuid_pref != NULL && CFDataGetLength(q->q_uuid_pref) == PERSISTENT_REF_UUID_BYTES_LENGTH && query_attr_count(q)) {
         return SecError(errSecItemIllegalQuery, error,
                         CFSTR("attributes to query illegal; both persistent ref and other attributes can't be searched at the same time"));
@@ -1089,6 +1109,18 @@ s3dl_copy_matching(SecDbConnectionRef dbt, Query *q, CFTypeRef *result,
     // Only copy things that aren't tombstones unless the client explicitly asks otherwise.
     if (!CFDictionaryContainsKey(q->q_item, kSecAttrTombstone))
         query_add_attribute(kSecAttrTombstone, kCFBooleanFalse, q);
+    return true;
+}
+
+bool
+s3dl_copy_matching(SecDbConnectionRef dbt, Query *q, CFTypeRef *result,
+                   CFArrayRef accessGroups, CFErrorRef *error)
+{
+    struct s3dl_query_ctx ctx = {
+        .q = q, .accessGroups = accessGroups, .dbt = dbt,
+    };
+    if (!s3dl_prepare_matching_query(q, error))
+        return false;
     bool ok = s3dl_query(s3dl_query_row, &ctx, error);
     if (ok && result)
         *result = ctx.result;
@@ -1098,6 +1130,26 @@ s3dl_copy_matching(SecDbConnectionRef dbt, Query *q, CFTypeRef *result,
     return ok;
 }
 
+bool
+s3dl_copy_matching_batched(SecDbConnectionRef dbt, Query *q, CFArrayRef accessGroups,
+                           CFIndex batchSize, CFErrorRef *error,
+                           bool (^batch)(CFArrayRef results))
+{
+    struct s3dl_query_ctx ctx = {
+        .q = q, .accessGroups = accessGroups, .dbt = dbt,
+        .batchSize = batchSize > 0 ? batchSize : kSecItemDbDefaultBatchSize,
+        .batch = batch,
+    };
+    if (!s3dl_prepare_matching_query(q, error))
+        return false;
+    bool ok = s3dl_query(s3dl_query_row, &ctx, error);
+    if (ok)
+        s3dl_query_flush_batch(&ctx);
+    CFReleaseSafe(ctx.result);
+
+    return ok;
+}
+
 typedef void (^s3dl_item_digest_callback)(CFDataRef persistantReference, CFDataRef encryptedData);
 
 struct s3dl_digest_ctx {
@@ -102,6 +102,15 @@ bool kc_transaction(SecDbConnectionRef dbt, CFErrorRef *error, bool(^perform)(vo
 bool kc_transaction_type(SecDbConnectionRef dbt, SecDbTransactionType type, CFErrorRef *error, bool(^perform)(void));
 bool s3dl_copy_matching(SecDbConnectionRef dbt, Query *q, CFTypeRef *result,
                         CFArrayRef accessGroups, CFErrorRef *error);
+
+/* Like s3dl_copy_matching(), but instead of materialising every match before
+   returning, hands results to batch in arrays of at most batchSize entries as
+   rows are stepped. Return false from batch to stop the query early. Item
+   secrets are only decrypted when q asks for data (or a filter needs it). */
+#define kSecItemDbDefaultBatchSize 64
+bool s3dl_copy_matching_batched(SecDbConnectionRef dbt, Query *q, CFArrayRef accessGroups,
+                                CFIndex batchSize, CFErrorRef *error,
+                                bool (^batch)(CFArrayRef results));
 bool s3dl_query_add(SecDbConnectionRef dbt, Query *q, CFTypeRef *result, CFErrorRef *error);
 bool s3dl_query_update(SecDbConnectionRef dbt, Query *q,
                   CFDictionaryRef attributesToUpdate, CFArrayRef accessGroups, CFErrorRef *error);
@@ -1765,6 +1765,41 @@ bool kc_with_custom_db(bool writeAndRead, bool usesItemTables, SecDbRef db, CFEr
     return ok;
 }
 
+/* Like kc_with_dbt(true, ...) wrapped around kc_transaction(), for small item writes.
+ Concurrent callers are committed together in one sqlite transaction by
+ SecDbPerformWriteTransaction(); each caller's work still commits, or rolls back
+ if perform returns false, on its own.  perform may run on another caller's thread. */
+bool kc_with_write_transaction(CFErrorRef *error, bool (^perform)(SecDbConnectionRef dbt))
+{
+    if (threadDbt) {
+        // Already holding a connection on this thread; queueing behind ourselves would deadlock.
+        SecDbConnectionRef dbt = threadDbt;
+        return kc_transaction(dbt, error, ^bool {
+            return perform(dbt);
+        });
+    }
+
+    SecDbRef db = kc_dbhandle(error);
+    if (db == NULL) {
+        if (error && !(*error)) {
+            SecError(errSecDataNotAvailable, error, CFSTR("failed to get a db handle"));
+        }
+        return false;
+    }
+
+#if SECUREOBJECTSYNC
+    SecItemDataSourceFactoryGetDefault();
+#endif
+
+    return SecDbPerformWriteTransaction(db, error, ^(SecDbConnectionRef dbconn, bool *commit) {
+        // Nested kc_with_dbt calls made by perform must use the group's connection.
+        SecDbConnectionRef oldDbt = threadDbt;
+        threadDbt = dbconn;
+        *commit = perform(dbconn);
+        threadDbt = oldDbt;
+    });
+}
+
 static bool
 items_matching_issuer_parent(SecDbConnectionRef dbt, CFArrayRef accessGroups, CFDataRef musrView,
                              CFDataRef issuer, CFArrayRef issuers, int recurse)
@@ -2173,7 +2208,7 @@ static bool appClipHasAcceptableAccessGroups(SecurityClient* client) {
 }
 
 static bool
-SecItemServerCopyMatching(CFDictionaryRef query, CFTypeRef *result,
+SecItemServerCopyMatching(CFDictionaryRef query, CFTypeRef *result, bool (^batch)(CFArrayRef results),
     SecurityClient *client, CFErrorRef *error)
 {
     if (nonAPIAttributesInDictionary(query)) {
@@ -2284,6 +2319,9 @@ SecItemServerCopyMatching(CFDictionaryRef query, CFTypeRef *result,
             ok = SecError(errSecReturnMissingPointer, error, CFSTR("missing pointer"));
         } else if (!q->q_error) {
             ok = kc_with_dbt(false, error, ^(SecDbConnectionRef dbt) {
+                if (batch && q->q_limit == kSecMatchUnlimited && q->q_return_type != 0) {
+                    return s3dl_copy_matching_batched(dbt, q, accessGroups, kSecItemDbDefaultBatchSize, error, batch);
+                }
                 return s3dl_copy_matching(dbt, q, result, accessGroups, error);
             });
         }
@@ -2301,7 +2339,13 @@ SecItemServerCopyMatching(CFDictionaryRef query, CFTypeRef *result,
 
 bool
 _SecItemCopyMatching(CFDictionaryRef query, SecurityClient *client, CFTypeRef *result, CFErrorRef *error) {
-    return SecItemServerCopyMatching(query, result, client, error);
+    return SecItemServerCopyMatching(query, result, NULL, client, error);
+}
+
+bool
+_SecItemCopyMatchingBatched(CFDictionaryRef query, SecurityClient *client, CFTypeRef *result,
+                            bool (^batch)(CFArrayRef results), CFErrorRef *error) {
+    return SecItemServerCopyMatching(query, result, batch, client, error);
 }
 
 static CFArrayRef
@@ -2416,11 +2460,9 @@ _SecItemAdd(CFDictionaryRef attributes, SecurityClient *client, CFTypeRef *resul
             } else if (q->q_row_id || q->q_token_object_id) {
                 ok = SecError(errSecValuePersistentRefUnsupported, error, CFSTR("q_row_id"));  // TODO: better error string
             } else if (!q->q_error) {
-                ok = kc_with_dbt(true, error, ^(SecDbConnectionRef dbt){
-                    return kc_transaction(dbt, error, ^{
-                        query_pre_add(q, true);
-                        return s3dl_query_add(dbt, q, result, error);
-                    });
+                ok = kc_with_write_transaction(error, ^(SecDbConnectionRef dbt){
+                    query_pre_add(q, true);
+                    return s3dl_query_add(dbt, q, result, error);
                 });
             }
         }
@@ -2595,10 +2637,8 @@ _SecItemUpdate(CFDictionaryRef query, CFDictionaryRef attributesToUpdate,
         }
     }
     if (ok) {
-        ok = kc_with_dbt(true, error, ^(SecDbConnectionRef dbt) {
-            return kc_transaction(dbt, error, ^{
-                return s3dl_query_update(dbt, q, attributesToUpdate, accessGroups, error);
-            });
+        ok = kc_with_write_transaction(error, ^(SecDbConnectionRef dbt) {
+            return s3dl_query_update(dbt, q, attributesToUpdate, accessGroups, error);
         });
     }
     if (q) {
@@ -2685,10 +2725,8 @@ _SecItemDelete(CFDictionaryRef query, SecurityClient *client, CFErrorRef *error)
         } else if (q->q_token_object_id && query_attr_count(q) != 1) {
             ok = SecError(errSecItemIllegalQuery, error, CFSTR("token persistent ref and other attributes are mutually exclusive"));
         } else {
-            ok = kc_with_dbt(true, error, ^(SecDbConnectionRef dbt) {
-                return kc_transaction(dbt, error, ^{
-                    return s3dl_query_delete(dbt, q, accessGroups, error);
-                });
+            ok = kc_with_write_transaction(error, ^(SecDbConnectionRef dbt) {
+                return s3dl_query_delete(dbt, q, accessGroups, error);
             });
         }
         ok = query_notify_and_destroy(q, ok, error);
@@ -42,6 +42,10 @@ __BEGIN_DECLS
 
 bool _SecItemAdd(CFDictionaryRef attributes, SecurityClient *client, CFTypeRef *result, CFErrorRef *error);
 bool _SecItemCopyMatching(CFDictionaryRef query, SecurityClient *client, CFTypeRef *result, CFErrorRef *error);
+// Like _SecItemCopyMatching, but a kSecMatchLimitAll query that returns something hands its results
+// to batch as they are read and leaves *result NULL; return false from batch to stop early.
+bool _SecItemCopyMatchingBatched(CFDictionaryRef query, SecurityClient *client, CFTypeRef *result,
+                                 bool (^batch)(CFArrayRef results), CFErrorRef *error);
 bool _SecItemUpdate(CFDictionaryRef query, CFDictionaryRef attributesToUpdate, SecurityClient *client, CFErrorRef *error);
 bool _SecItemDelete(CFDictionaryRef query, SecurityClient *client, CFErrorRef *error);
 bool _SecItemDeleteAll(CFErrorRef *error);
@@ -85,6 +89,7 @@ SecDbRef SecKeychainDbInitialize(SecDbRef db);
 bool kc_with_dbt(bool writeAndRead, CFErrorRef *error, bool (^perform)(SecDbConnectionRef dbt));
 bool kc_with_dbt_non_item_tables(bool writeAndRead, CFErrorRef* error, bool (^perform)(SecDbConnectionRef dbt)); // can be used when only tables which don't store 'items' are accessed - avoids invoking SecItemDataSourceFactoryGetDefault()
 bool kc_with_custom_db(bool writeAndRead, bool usesItemTables, SecDbRef db, CFErrorRef *error, bool (^perform)(SecDbConnectionRef dbt));
+bool kc_with_write_transaction(CFErrorRef *error, bool (^perform)(SecDbConnectionRef dbt)); // small, self-contained item writes; group-committed with concurrent callers
 
 bool UpgradeItemPhase3(SecDbConnectionRef inDbt, bool *inProgress, CFErrorRef *error);
 
@@ -67,6 +67,8 @@ struct _CMSDecoder {
     CMSDecoderState decState;
     SecCmsDecoderRef decoder;
     CFDataRef detachedContent;
+    SecCmsContentCallback contentCallback; /* optional, see CMSDecoderSetContentCallback */
+    void* contentCallbackArg;
 
     /*
      * The following are valid (and quiescent) after CMSDecoderFinalizeMessage().
@@ -218,7 +220,8 @@ OSStatus CMSDecoderUpdateMessage(CMSDecoderRef cmsDecoder, const void* msgBytes,
         case DS_Init:
             /* First time through; set up */
             ASSERT(cmsDecoder->decoder == NULL);
-            ortn = SecCmsDecoderCreate(NULL, NULL, NULL, NULL, NULL, NULL, &cmsDecoder->decoder);
+            ortn = SecCmsDecoderCreate(cmsDecoder->contentCallback, cmsDecoder->contentCallbackArg,
+                                       NULL, NULL, NULL, NULL, &cmsDecoder->decoder);
             if (ortn) {
                 ortn = cmsRtnToOSStatus(ortn);
                 CSSM_PERROR("SecCmsDecoderCreate", ortn);
@@ -737,6 +740,23 @@ OSStatus CMSDecoderSetDecoder(CMSDecoderRef cmsDecoder, SecCmsDecoderRef decoder
     return errSecSuccess;
 }
 
+/*
+ * Stream encapsulated content to a callback instead of buffering it.
+ * Must be called before the first call to CMSDecoderUpdateMessage().
+ */
+OSStatus CMSDecoderSetContentCallback(CMSDecoderRef cmsDecoder, SecCmsContentCallback callback, void* callbackArg)
+{
+    if ((cmsDecoder == NULL) || (callback == NULL)) {
+        return errSecParam;
+    }
+    if (cmsDecoder->decState != DS_Init) {
+        return errSecParam;
+    }
+    cmsDecoder->contentCallback = callback;
+    cmsDecoder->contentCallbackArg = callbackArg;
+    return errSecSuccess;
+}
+
 /*
  * Obtain the SecCmsDecoderRef associated with a CMSDecoderRef.
  * Returns a NULL SecCmsDecoderRef if neither CMSDecoderSetDecoder() nor
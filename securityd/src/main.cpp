@@ -226,6 +226,7 @@ int main(int argc, char *argv[])
 	if (maxThreads)
 		server.maxThreads(maxThreads);
 	server.floatingThread(true);
+	server.adaptiveThreads(true);
 	server.waitForClients(waitForClients);
 	server.verbosity(verbose);
 
@@ -327,7 +327,8 @@ kern_return_t self_server_handleSignal(mach_port_t sport,
 #endif //DEBUGDUMP
 
 		case SIGUSR2:
-            fprintf(stderr, "securityd ignoring SIGUSR2 received");
+			// dump per-request service times
+			Server::active().logLatency();
             break;
 
 		default:
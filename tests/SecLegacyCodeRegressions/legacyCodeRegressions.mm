@@ -3,6 +3,8 @@
 
 #import <XCTest/XCTest.h>
 #include <security_utilities/threading.h>
+#include <security_utilities/hashing.h>
+#include <vector>
 
 struct ThreadTestClass : public Thread {
     XCTestExpectation *expectation;
@@ -27,4 +29,29 @@ struct ThreadTestClass : public Thread {
     delete t;
 }
 
+- (void)testHashPages {
+    const size_t pageSize = 4096;
+    const size_t pageCount = 100;
+    const size_t length = pageSize * (pageCount - 1) - 100;    // short last page, and a page past the end
+    std::vector<unsigned char> data(length);
+    for (size_t n = 0; n < length; n++)
+        data[n] = (unsigned char)(n * 7 + n / 251);
+
+    const CCDigestAlg algs[] = { kCCDigestSHA1, kCCDigestSHA256, kCCDigestSHA384 };
+    for (CCDigestAlg alg : algs) {
+        RefPointer<DynamicHash> hasher = new CCHashInstance(alg);
+        size_t digestLength = hasher->digestLength();
+        std::vector<Hashing::Byte> digests(pageCount * digestLength);
+        hashPages(^{ return (DynamicHash *)new CCHashInstance(alg); }, digestLength,
+                  data.data(), length, pageSize, pageCount, digests.data());
+
+        for (size_t page = 0; page < pageCount; page++) {
+            size_t offset = std::min(page * pageSize, length);
+            RefPointer<DynamicHash> check = new CCHashInstance(alg);
+            check->update(data.data() + offset, std::min(pageSize, length - offset));
+            XCTAssertTrue(check->verify(&digests[page * digestLength]), "page %zu (alg %d)", page, alg);
+        }
+    }
+}
+
 @end
@@ -303,6 +303,7 @@ CF_ENUM(CFIndex) {
 #define kSecRevocationDbMinUpdateFormat     2  /* minimum version we can use */
 
 #define kSecRevocationDbCacheSize           100
+#define kSecRevocationDbFilterCacheSize     16
 
 typedef struct __SecRevocationDb *SecRevocationDbRef;
 struct __SecRevocationDb {
@@ -314,6 +315,7 @@ struct __SecRevocationDb {
     CFMutableArrayRef info_cache_list;
     CFMutableDictionaryRef info_cache;
     os_unfair_lock info_cache_lock;
+    CFMutableDictionaryRef filter_cache;    /* groupId -> [filter data, compiled filter]; uses info_cache_lock */
 };
 
 typedef struct __SecRevocationDbConnection *SecRevocationDbConnectionRef;
@@ -1740,6 +1742,7 @@ static SecRevocationDbRef SecRevocationDbInit(CFStringRef db_name) {
     rdb->updateInProgress = false;
     rdb->unsupportedVersion = false;
     rdb->changed = false;
+    rdb->filter_cache = NULL;
 
     require(rdb->db = SecRevocationDbCreate(db_name), errOut);
     attr = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_BACKGROUND, 0);
@@ -1747,6 +1750,7 @@ static SecRevocationDbRef SecRevocationDbInit(CFStringRef db_name) {
     require(rdb->update_queue = dispatch_queue_create(NULL, attr), errOut);
     require(rdb->info_cache_list = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks), errOut);
     require(rdb->info_cache = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks), errOut);
+    require(rdb->filter_cache = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks), errOut);
     rdb->info_cache_lock = OS_UNFAIR_LOCK_INIT;
 
     if (!isDbOwner()) {
@@ -1939,6 +1943,9 @@ static void SecRevocationDbCachePurge(SecRevocationDbRef db) {
     os_unfair_lock_lock(&db->info_cache_lock);
     CFArrayRemoveAllValues(db->info_cache_list);
     CFDictionaryRemoveAllValues(db->info_cache);
+    if (db->filter_cache) {
+        CFDictionaryRemoveAllValues(db->filter_cache);
+    }
     secdebug("validcache", "cache purge");
     os_unfair_lock_unlock(&db->info_cache_lock);
 }
@@ -3524,41 +3531,30 @@ errOut:
     return result;
 }
 
-static bool _SecRevocationDbSerialInFilter(SecRevocationDbConnectionRef dbc,
-                                           CFDataRef serialData,
-                                           CFDataRef xmlData) {
-    /* N-To-1 filter implementation.
-       The 'xmlData' parameter is a flattened XML dictionary,
-       containing 'xor' and 'params' keys. First order of
-       business is to reconstitute the blob into components.
-    */
-    bool result = false;
-    CFRetainSafe(xmlData);
-    CFDataRef propListData = xmlData;
-    /* Expand data blob if needed */
-    CFDataRef inflatedData = copyInflatedData(propListData);
-    if (inflatedData) {
-        CFReleaseSafe(propListData);
-        propListData = inflatedData;
-    }
+/* A compiled N-To-1 filter holds what a lookup needs from the filter
+   plist in one flat buffer: the hash parameters followed by the raw
+   Bloom filter bits. Matching against it needs no inflate or plist parse. */
+typedef struct {
+    uint32_t paramCount;
+    uint32_t bitsLength;        /* in bytes */
+    uint32_t params[];          /* followed by bitsLength bytes of filter */
+} SecNto1Filter;
+
+static CF_RETURNS_RETAINED CFDataRef copyCompiledFilter(CFDataRef xmlData) {
     CFDataRef xor = NULL;
     CFArrayRef params = NULL;
-    CFPropertyListRef nto1 = CFPropertyListCreateWithData(kCFAllocatorDefault, propListData, 0, NULL, NULL);
-    if (nto1) {
-        xor = (CFDataRef)CFDictionaryGetValue((CFDictionaryRef)nto1, CFSTR("xor"));
-        params = (CFArrayRef)CFDictionaryGetValue((CFDictionaryRef)nto1, CFSTR("params"));
-    }
-    uint8_t *hash = (xor) ? (uint8_t*)CFDataGetBytePtr(xor) : NULL;
-    CFIndex hashLen = (hash && CFDataGetLength(xor) > 0) ? CFDataGetLength(xor) : 0;
-    uint8_t *serial = (serialData) ? (uint8_t*)CFDataGetBytePtr(serialData) : NULL;
-    CFIndex serialLen = (serial) ? CFDataGetLength(serialData) : 0;
+    CFMutableDataRef result = NULL;
 
-    require(hash && hashLen > 0 && serial && params, errOut);
-
-    const uint32_t FNV_OFFSET_BASIS = 2166136261;
-    const uint32_t FNV_PRIME = 16777619;
-    bool notInHash = false;
+    require_quiet(copyFilterComponents(xmlData, &xor, &params), errOut);
+    require_quiet(isData(xor) && isArray(params), errOut);
+    CFIndex bitsLength = CFDataGetLength(xor);
     CFIndex ix, count = CFArrayGetCount(params);
+    require_quiet(bitsLength > 0 && bitsLength <= UINT32_MAX, errOut);
+
+    require(result = CFDataCreateMutable(NULL, 0), errOut);
+    CFDataSetLength(result, (CFIndex)sizeof(SecNto1Filter) + count * (CFIndex)sizeof(uint32_t) + bitsLength);
+    SecNto1Filter *filter = (SecNto1Filter *)CFDataGetMutableBytePtr(result);
+    uint32_t paramCount = 0;
     for (ix = 0; ix < count; ix++) {
         int32_t param;
         CFNumberRef cfnum = (CFNumberRef)CFArrayGetValueAtIndex(params, ix);
@@ -3568,26 +3564,102 @@ static bool _SecRevocationDbSerialInFilter(SecRevocationDbConnectionRef dbc,
             secinfo("validupdate", "error processing filter params at index %ld", (long)ix);
             continue;
         }
+        filter->params[paramCount++] = (uint32_t)param;
+    }
+    filter->paramCount = paramCount;
+    filter->bitsLength = (uint32_t)bitsLength;
+    memcpy(&filter->params[paramCount], CFDataGetBytePtr(xor), (size_t)bitsLength);
+    CFDataSetLength(result, (CFIndex)sizeof(SecNto1Filter) + (CFIndex)(paramCount * sizeof(uint32_t)) + bitsLength);
+
+errOut:
+    CFReleaseSafe(xor);
+    CFReleaseSafe(params);
+    return result;
+}
+
+static bool serialInCompiledFilter(CFDataRef compiled, CFDataRef serialData) {
+    const SecNto1Filter *filter = (const SecNto1Filter *)CFDataGetBytePtr(compiled);
+    const uint8_t *hash = (const uint8_t *)&filter->params[filter->paramCount];
+    const uint8_t *serial = CFDataGetBytePtr(serialData);
+    CFIndex serialLen = CFDataGetLength(serialData);
+
+    const uint32_t FNV_OFFSET_BASIS = 2166136261;
+    const uint32_t FNV_PRIME = 16777619;
+    for (uint32_t ix = 0; ix < filter->paramCount; ix++) {
         /* process one param */
-        uint32_t hval = FNV_OFFSET_BASIS ^ (uint32_t)param;
+        uint32_t hval = FNV_OFFSET_BASIS ^ filter->params[ix];
         CFIndex i = serialLen;
         while (i > 0) {
             hval = ((hval ^ (serial[--i])) * FNV_PRIME) & 0xFFFFFFFF;
         }
-        hval = hval % ((unsigned long)hashLen * 8);
+        hval = hval % ((unsigned long)filter->bitsLength * 8);
         if ((hash[hval/8] & (1 << (hval % 8))) == 0) {
-            notInHash = true; /* definitely not in hash */
-            break;
+            return false; /* definitely not in hash */
         }
     }
-    if (!notInHash) {
-        /* probabilistically might be in hash if we get here. */
-        result = true;
+    /* probabilistically might be in hash if we get here. */
+    return true;
+}
+
+/* Return the compiled form of a group's filter, compiling it at most once
+   per group between database updates. The cached entry remembers the filter
+   data it was compiled from, so it can never answer for a different filter. */
+static CF_RETURNS_RETAINED CFDataRef SecRevocationDbCopyCompiledFilter(SecRevocationDbRef db,
+                                                                       int64_t groupId,
+                                                                       CFDataRef xmlData) {
+    if (!db || !db->filter_cache || groupId <= 0) {
+        return copyCompiledFilter(xmlData);
+    }
+    CFDataRef result = NULL;
+    CFNumberRef cacheKey = CFNumberCreate(NULL, kCFNumberSInt64Type, &groupId);
+
+    os_unfair_lock_lock(&db->info_cache_lock);
+    CFArrayRef entry = (CFArrayRef)CFDictionaryGetValue(db->filter_cache, cacheKey);
+    if (entry && CFEqualSafe(CFArrayGetValueAtIndex(entry, 0), xmlData)) {
+        result = (CFDataRef)CFRetainSafe(CFArrayGetValueAtIndex(entry, 1));
+    }
+    os_unfair_lock_unlock(&db->info_cache_lock);
+    if (result) {
+        secdebug("validcache", "filter cache hit: group %lld", (long long)groupId);
+        CFReleaseSafe(cacheKey);
+        return result;
     }
 
+    /* compile outside the lock; filters can be large */
+    result = copyCompiledFilter(xmlData);
+    if (result) {
+        const void *values[] = { xmlData, result };
+        CFArrayRef newEntry = CFArrayCreate(NULL, values, 2, &kCFTypeArrayCallBacks);
+        os_unfair_lock_lock(&db->info_cache_lock);
+        if (kSecRevocationDbFilterCacheSize <= CFDictionaryGetCount(db->filter_cache)) {
+            secdebug("validcache", "filter cache full, purging");
+            CFDictionaryRemoveAllValues(db->filter_cache);
+        }
+        CFDictionarySetValue(db->filter_cache, cacheKey, newEntry);
+        os_unfair_lock_unlock(&db->info_cache_lock);
+        CFReleaseSafe(newEntry);
+        secdebug("validcache", "filter cache add: group %lld", (long long)groupId);
+    }
+    CFReleaseSafe(cacheKey);
+    return result;
+}
+
+static bool _SecRevocationDbSerialInFilter(SecRevocationDbConnectionRef dbc,
+                                           int64_t groupId,
+                                           CFDataRef serialData,
+                                           CFDataRef xmlData) {
+    /* N-To-1 filter implementation.
+       The 'xmlData' parameter is a flattened XML dictionary,
+       containing 'xor' and 'params' keys. We match against its
+       compiled form, cached per group when we have a database. */
+    bool result = false;
+    CFDataRef filter = NULL;
+    require_quiet(serialData && CFDataGetBytePtr(serialData), errOut);
+    require_quiet(filter = SecRevocationDbCopyCompiledFilter((dbc) ? dbc->db : NULL, groupId, xmlData), errOut);
+    result = serialInCompiledFilter(filter, serialData);
+
 errOut:
-    CFReleaseSafe(nto1);
-    CFReleaseSafe(propListData);
+    CFReleaseSafe(filter);
     return result;
 }
 
@@ -3634,7 +3706,7 @@ static SecValidInfoRef _SecRevocationDbValidInfoForCertificate(SecRevocationDbCo
         /* Perform a Bloom filter match against the serial. If matched is false,
            then the cert is definitely not in the list. But if matched is true,
            we don't know for certain, so we would need to check OCSP. */
-        matched = _SecRevocationDbSerialInFilter(dbc, serial, data);
+        matched = _SecRevocationDbSerialInFilter(dbc, groupId, serial, data);
     }
 
     if (matched) {
@@ -3809,7 +3881,7 @@ bool SecRevocationDbContainsIssuer(SecCertificateRef issuer) {
 
 /* Return true if the serial number data is matched in the provided filter. */
 bool SecRevocationDbSerialInFilter(CFDataRef serialData, CFDataRef xmlData) {
-    return _SecRevocationDbSerialInFilter(NULL, serialData, xmlData);
+    return _SecRevocationDbSerialInFilter(NULL, 0, serialData, xmlData);
 }
 
 /* Return the current version of the revocation database.
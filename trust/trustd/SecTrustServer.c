@@ -316,6 +316,10 @@ static void SecPathBuilderForEachPVC(SecPathBuilderRef builder,void (^operation)
 static void SecPathBuilderDestroy(CFTypeRef cf) {
     SecPathBuilderRef builder = (SecPathBuilderRef)cf;
     secdebug("alloc", "destroy builder %p", builder);
+    SecCertificateInternStatistics internStats;
+    SecCertificateGetInternStatistics(&internStats);
+    secdebug("intern", "certificate interning: %llu hits, %llu misses, %llu evictions, %llu bytes shared",
+             internStats.hits, internStats.misses, internStats.evictions, internStats.bytesShared);
     dispatch_release_null(builder->queue);
     if (builder->anchorSource) {
         SecMemoryCertificateSourceDestroy(builder->anchorSource);
@@ -873,6 +877,23 @@ static bool SecPathBuilderProcessLeaf(SecPathBuilderRef builder) {
     return true;
 }
 
+/* Verify the signatures of several newly constructed paths concurrently.
+   SecCertificatePathVCVerify() only touches its own path, and remembers how
+   far it got, so the serial SecPathBuilderIsPartial() calls that follow find
+   the work done and still make every decision in the original order. */
+static void SecPathBuilderVerifyPaths(CFArrayRef paths) {
+    CFIndex count = CFArrayGetCount(paths);
+    if (count < 2) {
+        /* Nothing to overlap, leave it to SecPathBuilderIsPartial(). */
+        return;
+    }
+    dispatch_apply((size_t)count, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t ix) {
+        SecCertificatePathVCRef path = (SecCertificatePathVCRef)
+            CFArrayGetValueAtIndex(paths, (CFIndex)ix);
+        (void)SecCertificatePathVCVerify(path);
+    });
+}
+
 /* Given the builder, a partial chain partial and the parents array, construct
    a SecCertificatePath for each parent.  After discarding previously
    considered paths and paths with cycles, sort out which array each path
@@ -882,6 +903,8 @@ static void SecPathBuilderProcessParents(SecPathBuilderRef builder,
     CFIndex rootIX = SecCertificatePathVCGetCount(partial) - 1;
     CFIndex num_parents = parents ? CFArrayGetCount(parents) : 0;
     CFIndex parentIX;
+    /* Paths new to allPaths, in parent order; retained only by allPaths. */
+    CFMutableArrayRef newPaths = CFArrayCreateMutable(kCFAllocatorDefault, num_parents, NULL);
     for (parentIX = 0; parentIX < num_parents; ++parentIX) {
         SecCertificateRef parent = (SecCertificateRef)
             CFArrayGetValueAtIndex(parents, parentIX);
@@ -912,18 +935,30 @@ static void SecPathBuilderProcessParents(SecPathBuilderRef builder,
             CFSetAddValue(builder->allPaths, path);
             if (is_anchor)
                 SecCertificatePathVCSetIsAnchored(path);
-            if (SecPathBuilderIsPartial(builder, path)) {
-                /* Insert path right at the current position since it's a new
-                   candiate partial. */
-                CFArrayInsertValueAtIndex(builder->partialPaths,
-                    ++builder->partialIX, path);
-                secdebug("trust", "Adding partial for parent %" PRIdCFIndex "/%" PRIdCFIndex " %@",
-                    parentIX + 1, num_parents, path);
-            }
+            CFArrayAppendValue(newPaths, path);
             secdebug("trust", "found new path %@", path);
         }
         CFRelease(path);
     }
+
+    /* Cross-signed hierarchies give us several parents at once; check their
+       signatures side by side before sorting the paths out one at a time. */
+    SecPathBuilderVerifyPaths(newPaths);
+
+    CFIndex newIX, num_new = CFArrayGetCount(newPaths);
+    for (newIX = 0; newIX < num_new; ++newIX) {
+        SecCertificatePathVCRef path = (SecCertificatePathVCRef)
+            CFArrayGetValueAtIndex(newPaths, newIX);
+        if (SecPathBuilderIsPartial(builder, path)) {
+            /* Insert path right at the current position since it's a new
+               candiate partial. */
+            CFArrayInsertValueAtIndex(builder->partialPaths,
+                ++builder->partialIX, path);
+            secdebug("trust", "Adding partial %" PRIdCFIndex "/%" PRIdCFIndex " %@",
+                newIX + 1, num_new, path);
+        }
+    }
+    CFRelease(newPaths);
 }
 
 /* Callback for the SecPathBuilderGetNext() functions call to
@@ -26,6 +26,7 @@
 
 #include "../utilities/SecFileLocations.h"
 #include "../utilities/debugging.h"
+#include <Security/SecCertificateInternal.h>
 
 #include "../sec/ipc/securityd_client.h"
 #include "trust/trustd/SecPolicyServer.h"
@@ -90,6 +91,8 @@ void trustd_init(CFURLRef home_path) {
 
 void trustd_init_server(void) {
     gTrustd = &trustd_spi;
+    // trustd sees the same intermediates and roots over and over; share their parsed form
+    SecCertificateSetInterningEnabled(true);
 #ifdef LIBTRUSTD
     if (TrustdVariantAllowsFileWrite()) {
         // Migrate files to DataVault